@@ -55,8 +55,10 @@ int main()
     nbt::compound *parsed_nbt[50000];
     std::unique_ptr<char[]> nbt_data_copies[50000];
 
-    auto pmr_buf = malloc(40000l * 50000l);
-    auto pmr_rsrc = new std::pmr::monotonic_buffer_resource(pmr_buf, 40000l * 50000l);
+    // Every copy is the same file, so one scan tells exactly how much all of them will need.
+    auto pmr_buf_size = nbt::compound::heap_bytes(nbt_data_ptr.get(), nbt_data_size) * 50000l;
+    auto pmr_buf = malloc(pmr_buf_size);
+    auto pmr_rsrc = new std::pmr::monotonic_buffer_resource(pmr_buf, pmr_buf_size);
 
     for (int index = 0; index < 50000; index++)
     {
@@ -0,0 +1,142 @@
+#include <algorithm>
+#include <bit>
+#include "columns.h"
+#include "util/parallel.h"
+
+namespace melon::nbt
+{
+    namespace
+    {
+        // Rows are handed out in runs that fill whole bitmap words, so no two threads share one.
+        constexpr size_t rows_per_run = 1024;
+        static_assert(rows_per_run % 64 == 0);
+
+        column::storage_t make_storage(tag_type_enum type, size_t rows)
+        {
+            // @formatter:off
+            switch (type)
+            {
+                case tag_byte:   return std::vector<int8_t>(rows);
+                case tag_short:  return std::vector<int16_t>(rows);
+                case tag_int:    return std::vector<int32_t>(rows);
+                case tag_long:   return std::vector<int64_t>(rows);
+                case tag_float:  return std::vector<float>(rows);
+                case tag_double: return std::vector<double>(rows);
+                case tag_string: return std::vector<std::string_view>(rows);
+                default:         throw std::runtime_error("Only fixed size primitives and strings can be extracted into columns.");
+            }
+            // @formatter:on
+        }
+
+        // Runs rows_in_run(first, last) over the batch, a run of rows at a time.
+        void run_batch(size_t rows, unsigned threads, const auto &rows_in_run)
+        {
+            util::run_parallel((rows + rows_per_run - 1) / rows_per_run, threads, [&](size_t run) {
+                rows_in_run(run * rows_per_run, std::min(rows, (run + 1) * rows_per_run));
+            });
+        }
+    }
+
+    // Stores a row of a column. Only ever called for rows in the calling thread's own run.
+    class column_writer
+    {
+    public:
+        template<class T>
+        static void write(column &out, size_t row, T value)
+        {
+            std::get<std::vector<T>>(out.values_v)[row] = value;
+            out.present_v[row / 64] |= uint64_t(1) << (row % 64);
+        }
+    };
+
+    column::column(tag_type_enum type_in, size_t rows_in)
+            : type_v(type_in),
+              rows(rows_in),
+              present_v((rows_in + 63) / 64),
+              values_v(make_storage(type_in, rows_in))
+    { }
+
+    size_t column::null_count() const noexcept
+    {
+        size_t present_rows = 0;
+
+        for (auto word: present_v)
+            present_rows += std::popcount(word);
+
+        return rows - present_rows;
+    }
+
+    std::vector<column> extract_columns(std::span<compound *const> documents, std::span<const column_spec> specs, unsigned threads)
+    {
+        std::vector<column> columns;
+        columns.reserve(specs.size());
+
+        for (auto &spec: specs)
+            columns.emplace_back(spec.type, documents.size());
+
+        if (std::ranges::any_of(documents, [](const compound *document) { return document->is_lazy(); })) threads = 1;
+
+        run_batch(documents.size(), threads, [&](size_t first, size_t last) {
+            for (auto row = first; row < last; row++)
+            {
+                for (size_t idx = 0; idx < specs.size(); idx++)
+                {
+                    auto found = specs[idx].path.first(std::as_const(*documents[row]));
+
+                    // The alternatives of a const_tag_variant_t are in tag type order.
+                    if (!found || found->index() != static_cast<size_t>(specs[idx].type)) continue;
+
+                    std::visit([&](auto &&value) {
+                        using value_t = std::remove_cvref_t<decltype(value)>;
+
+                        if constexpr (std::is_same_v<value_t, std::string_view>)
+                            column_writer::write(columns[idx], row, value);
+                        else if constexpr (requires { requires std::is_arithmetic_v<typename value_t::type>; })
+                            column_writer::write(columns[idx], row, value.get());
+                    }, *found);
+                }
+            }
+        });
+
+        return columns;
+    }
+
+    std::vector<column> extract_columns(std::span<const std::span<const char>> documents, std::span<const column_spec> specs, unsigned threads)
+    {
+        std::vector<column> columns;
+        columns.reserve(specs.size());
+
+        for (auto &spec: specs)
+            columns.emplace_back(spec.type, documents.size());
+
+        run_batch(documents.size(), threads, [&](size_t first, size_t last) {
+            for (auto row = first; row < last; row++)
+            {
+                for (size_t idx = 0; idx < specs.size(); idx++)
+                {
+                    specs[idx].path.visit(documents[row].data(), documents[row].size(), [&](const tag_path::raw_match &match) {
+                        if (match.type != specs[idx].type) return false;
+
+                        // @formatter:off
+                        switch (match.type)
+                        {
+                            case tag_byte:   column_writer::write(columns[idx], row, match.get<tag_byte>()); break;
+                            case tag_short:  column_writer::write(columns[idx], row, match.get<tag_short>()); break;
+                            case tag_int:    column_writer::write(columns[idx], row, match.get<tag_int>()); break;
+                            case tag_long:   column_writer::write(columns[idx], row, match.get<tag_long>()); break;
+                            case tag_float:  column_writer::write(columns[idx], row, match.get<tag_float>()); break;
+                            case tag_double: column_writer::write(columns[idx], row, match.get<tag_double>()); break;
+                            case tag_string: column_writer::write(columns[idx], row, match.get_string()); break;
+                            default:         break;
+                        }
+                        // @formatter:on
+
+                        return false;
+                    });
+                }
+            }
+        });
+
+        return columns;
+    }
+}
@@ -0,0 +1,79 @@
+#ifndef MELON_NBT_COLUMNS_H
+#define MELON_NBT_COLUMNS_H
+
+#include <span>
+#include <string_view>
+#include <variant>
+#include <vector>
+#include "tag_path.h"
+
+namespace melon::nbt
+{
+    // A value to pull out of every document of a batch: the first tag path leads to, if it's of type. Fixed size primitives and strings can be
+    // pulled out.
+    struct column_spec
+    {
+        tag_path      path;
+        tag_type_enum type;
+    };
+
+    // The values of one column_spec across a batch, one row per document, side by side in a single vector. A document with no such tag, or a
+    // tag of another type, has its bit in the present bitmap cleared and a zero (or empty string) for a value.
+    //
+    // Strings are views of the documents themselves, left as Modified UTF-8, so they're only good as long as the documents are.
+    class column
+    {
+    public:
+        using storage_t = std::variant<std::vector<int8_t>, std::vector<int16_t>, std::vector<int32_t>, std::vector<int64_t>, std::vector<float>,
+                                       std::vector<double>, std::vector<std::string_view>>;
+
+        column(tag_type_enum type_in, size_t rows_in);
+
+        [[nodiscard]] tag_type_enum type() const noexcept
+        { return type_v; }
+
+        [[nodiscard]] size_t size() const noexcept
+        { return rows; }
+
+        [[nodiscard]] bool present(size_t row) const noexcept
+        { return (present_v[row / 64] >> (row % 64)) & 1; }
+
+        // One bit per row, starting from the low bit of the first word. Bits past the last row are clear.
+        [[nodiscard]] std::span<const uint64_t> present_bits() const noexcept
+        { return present_v; }
+
+        [[nodiscard]] size_t null_count() const noexcept;
+
+        template<tag_type_enum tag_type>
+        requires is_nbt_primitive<tag_type>
+        [[nodiscard]] std::span<const tag_prim_t<tag_type>> values() const
+        { return std::get<std::vector<tag_prim_t<tag_type>>>(values_v); }
+
+        template<tag_type_enum tag_type>
+        requires (tag_type == tag_string)
+        [[nodiscard]] std::span<const std::string_view> values() const
+        { return std::get<std::vector<std::string_view>>(values_v); }
+
+    private:
+        friend class column_writer;
+
+        tag_type_enum         type_v;
+        size_t                rows;
+        std::vector<uint64_t> present_v;
+        storage_t             values_v;
+    };
+
+    // Pulls every column_spec out of every document, returning a column per spec in the same order. Documents are split into runs of rows
+    // that are handed out to threads as they finish their last, so threads never write to the same bitmap word. threads defaults to one per
+    // core. The first exception thrown by any of the threads is rethrown once they've all stopped.
+    //
+    // Lazy compounds are read as they're reached, allocating from the memory resource and name pool of their tree. Documents often share
+    // those, and neither has to be thread safe, so if any document is lazy the whole batch is read on the calling thread.
+    std::vector<column> extract_columns(std::span<compound *const> documents, std::span<const column_spec> specs, unsigned threads = 0);
+
+    // Does the same over binary NBT buffers, walking each buffer once per spec and skipping everything a path doesn't lead through. As with
+    // parsing, each buffer includes the 8 bytes of padding, and a malformed buffer throws.
+    std::vector<column> extract_columns(std::span<const std::span<const char>> documents, std::span<const column_spec> specs, unsigned threads = 0);
+}
+
+#endif //MELON_NBT_COLUMNS_H
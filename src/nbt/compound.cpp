@@ -3,8 +3,10 @@
 //
 
 #include "list.h"
+#include "list_index.h"
 #include "compound.h"
 #include "snbt.h"
+#include "util/parallel.h"
 
 // For details on the file format go to: https://minecraft.fandom.com/wiki/NBT_format#Binary_format
 
@@ -14,7 +16,6 @@ namespace melon::nbt
             : parent(static_cast<compound *>(nullptr)),
               top(this),
               pmr_rsrc(alloc.resource()),
-              name(mem::pmr::make_unique<std::pmr::string>(pmr_rsrc, name_in)),
               tags(tag_list_t(pmr_rsrc)),
               depth(1),
               max_bytes(max_bytes_in)
@@ -23,80 +24,137 @@ namespace melon::nbt
             [[unlikely]]
                     throw std::runtime_error("Attempted to create NBT compound with too large name.");
 
-        // TAG type + name length value + name length + END TAG type
-        this->adjust_byte_count(sizeof(int8_t) + sizeof(uint16_t) + name_in.size() + sizeof(int8_t));
+        name = nbt::tag_name::copy_of(name_in, pmr_rsrc);
 
         try
         {
+            // TAG type + name length value + name length + END TAG type
+            this->adjust_byte_count(sizeof(int8_t) + sizeof(uint16_t) + name_in.size() + sizeof(int8_t));
+
             if (builder) builder(*this);
         }
         catch (...)
         {
             clear();
+            name.release(pmr_rsrc);
             throw;
         }
     }
 
-    compound::compound(std::unique_ptr<char[]> raw, size_t raw_size, const allocator_type &alloc)
+    compound::compound(std::unique_ptr<char[]> &&raw_in, size_t raw_size, parse_args args, arena_ptr arena_in, const projection::node *keep, const allocator_type &alloc)
             : parent(static_cast<compound *>(nullptr)),
               top(this),
-              pmr_rsrc(alloc.resource()),
-              name(mem::pmr::make_unique<std::pmr::string>(pmr_rsrc, "")),
+              state([&] {
+                  auto threaded = (args.threads == 0 ? std::thread::hardware_concurrency() > 1 : args.threads > 1) && !arena_in && !args.lazy &&
+                                  !args.intern_names && args.names == nullptr;
+
+                  return std::make_unique<tree_state>(tree_state{
+                      .arena       = std::move(arena_in),
+                      .shared_pool = threaded ? std::make_unique<std::pmr::synchronized_pool_resource>(alloc.resource()) : nullptr,
+                      .raw         = nullptr,
+                      .own_names   = nullptr,
+                      .names       = args.names,
+                      .lazy        = args.lazy });
+              }()),
+              pmr_rsrc(state->arena ? state->arena.get() : state->shared_pool ? state->shared_pool.get() : alloc.resource()),
               tags(tag_list_t(pmr_rsrc)),
               depth(1),
+              borrows(args.borrow_buffer || args.lazy),
               max_bytes(-1)
     {
         if (raw_size < 5) [[unlikely]] throw std::runtime_error("NBT Compound Tag Too Small.");
 
-        auto itr = raw.get();
+        auto &names = state->names;
+
+        if (names == nullptr && args.intern_names)
+        {
+            state->own_names = std::make_unique<name_pool>(alloc);
+            names            = state->own_names.get();
+            interns          = true;
+        }
+
+        auto itr     = raw_in.get();
+        auto itr_end = raw_in.get() + raw_size;
         if (static_cast<tag_type_enum>(*itr++) != tag_compound) [[unlikely]] throw std::runtime_error("NBT tag type not compound.");
 
         try
         {
             auto name_len = impl::read_var<uint16_t>(itr);
-            *name = std::string_view(itr, name_len);
+            impl::check_name_bounds(itr, itr_end, name_len);
+
+            if (borrows)
+                name = nbt::tag_name::borrow({ itr, name_len });
+            else if (names != nullptr)
+                name = names->name_of({ itr, name_len });
+            else
+                name = nbt::tag_name::copy_of({ itr, name_len }, pmr_rsrc);
 
             itr += name_len;
             byte_count_v += 3 + name_len;
 
-            read(itr, raw.get() + raw_size);
+            parser::read(*this, itr, itr_end, keep, state->shared_pool ? args.threads : 1);
         }
         catch (...)
         {
             clear();
+            name.release(pmr_rsrc);
             throw;
         }
+
+        if (borrows) state->raw = std::move(raw_in);
     }
 
-    compound::compound(std::variant<compound *, list *> parent_in, std::string_view name_in)
-            : parent(parent_in),
-              top(std::visit([](auto &&tag) -> compound * { return tag->top; }, parent_in)),
-              pmr_rsrc(std::visit([](auto &&tag) -> std::pmr::memory_resource * { return tag->pmr_rsrc; }, parent_in)),
-              name(mem::pmr::make_unique<std::pmr::string>(pmr_rsrc, name_in)),
-              tags(tag_list_t(pmr_rsrc))
+    size_t compound::heap_bytes(const char *raw, size_t raw_size, parse_args args)
     {
-        if (name_in.size() > std::numeric_limits<uint16_t>::max()) [[unlikely]] throw std::runtime_error("Attempted to create NBT compound with too large name.");
+        if (raw_size < 5) [[unlikely]] throw std::runtime_error("NBT Compound Tag Too Small.");
 
-        std::visit([this](auto &&tag) {
-            depth     = tag->depth + 1;
-            max_bytes = tag->max_bytes;
-        }, parent_in);
+        // The walk only ever reads through itr.
+        auto itr     = const_cast<char *>(raw);
+        auto itr_end = raw + raw_size;
+        if (static_cast<tag_type_enum>(*itr++) != tag_compound) [[unlikely]] throw std::runtime_error("NBT tag type not compound.");
 
-        if (depth > 512) [[unlikely]] throw std::runtime_error("NBT Depth exceeds 512.");
+        auto name_len = impl::read_var<uint16_t>(itr);
+        impl::check_name_bounds(itr, itr_end, name_len);
 
-        if (std::holds_alternative<list *>(parent_in))
-            this->adjust_byte_count(sizeof(int8_t));
-        else
-            this->adjust_byte_count(sizeof(int8_t) + sizeof(uint16_t) + name_in.size() + sizeof(int8_t));
+        itr += name_len;
+
+        // Interned names come out of the pool, which allocates from upstream rather than the arena.
+        auto borrows    = args.borrow_buffer || args.lazy;
+        auto interns    = args.intern_names || args.names != nullptr;
+        auto name_bytes = (borrows || interns || name_len == 0) ? 0 : parser::arena_slot(name_len);
+
+        return name_bytes + parser::heap_bytes(itr, itr_end, 1, borrows, args.lazy, interns);
     }
 
-    compound::compound(char **itr_in, const char *itr_end, std::variant<compound *, list *> parent_in, mem::pmr::unique_ptr<std::pmr::string> name_in)
+    compound::arena_ptr compound::make_arena(size_t bytes, std::pmr::memory_resource *upstream)
+    {
+        using arena_t = std::pmr::monotonic_buffer_resource;
+        static_assert(alignof(arena_t) >= parser::arena_align);
+
+        // The buffer follows the arena itself, so the whole thing goes back to upstream in one piece.
+        constexpr auto arena_bytes = parser::arena_slot(sizeof(arena_t));
+        auto           block_bytes = arena_bytes + std::max(bytes, parser::arena_align);
+        auto           block       = static_cast<char *>(upstream->allocate(block_bytes, alignof(arena_t)));
+
+        auto arena_rsrc = ::new(block) arena_t(block + arena_bytes, block_bytes - arena_bytes, upstream);
+
+        return { arena_rsrc, { .upstream = upstream, .bytes = block_bytes } };
+    }
+
+    void compound::arena_deleter::operator()(std::pmr::monotonic_buffer_resource *ptr) const noexcept
+    {
+        std::destroy_at(ptr);
+        upstream->deallocate(ptr, bytes, alignof(std::pmr::monotonic_buffer_resource));
+    }
+
+    compound::compound(std::variant<compound *, list *> parent_in, std::string_view name_in)
             : parent(parent_in),
               top(std::visit([](auto &&tag) -> compound * { return tag->top; }, parent_in)),
               pmr_rsrc(std::visit([](auto &&tag) -> std::pmr::memory_resource * { return tag->pmr_rsrc; }, parent_in)),
-              name(name_in.get() != nullptr ? std::move(name_in) : mem::pmr::make_unique<std::pmr::string>(pmr_rsrc, "")),
               tags(tag_list_t(pmr_rsrc))
     {
+        if (name_in.size() > std::numeric_limits<uint16_t>::max()) [[unlikely]] throw std::runtime_error("Attempted to create NBT compound with too large name.");
+
         std::visit([this](auto &&tag) {
             depth     = tag->depth + 1;
             max_bytes = tag->max_bytes;
@@ -104,20 +162,38 @@ namespace melon::nbt
 
         if (depth > 512) [[unlikely]] throw std::runtime_error("NBT Depth exceeds 512.");
 
-        if (std::holds_alternative<compound *>(parent_in))
-            byte_count_v += sizeof(uint16_t) + name->size() + sizeof(int8_t); // compound::read parent reads the compound tag type
+        name = nbt::tag_name::copy_of(name_in, pmr_rsrc);
 
         try
         {
-            *itr_in = read(*itr_in, itr_end);
+            if (std::holds_alternative<list *>(parent_in))
+                this->adjust_byte_count(sizeof(int8_t));
+            else
+                this->adjust_byte_count(sizeof(int8_t) + sizeof(uint16_t) + name_in.size() + sizeof(int8_t));
         }
         catch (...)
         {
-            clear();
+            name.release(pmr_rsrc);
             throw;
         }
     }
 
+    compound::compound(const impl::parse_node_args &args)
+            : parent(args.parent),
+              top(args.top),
+              pmr_rsrc(args.pmr_rsrc),
+              name(args.name),
+              tags(tag_list_t(pmr_rsrc)),
+              depth(args.depth),
+              max_bytes(args.max_bytes)
+    {
+        // Counted as empty until the parser closes it.
+        if (std::holds_alternative<list *>(parent))
+            byte_count_v = sizeof(int8_t);
+        else
+            byte_count_v = sizeof(int8_t) + sizeof(uint16_t) + name.size() + sizeof(int8_t);
+    }
+
     compound::~compound()
     {
         clear();
@@ -125,110 +201,55 @@ namespace melon::nbt
         if (std::holds_alternative<list *>(parent))
             adjust_byte_count(sizeof(int8_t) * -1);
         else
-            adjust_byte_count((sizeof(int8_t) + sizeof(uint16_t) + name->size() + sizeof(int8_t)) * -1);
+            adjust_byte_count((sizeof(int8_t) + sizeof(uint16_t) + name.size() + sizeof(int8_t)) * -1);
+
+        name.release(pmr_rsrc);
 
         assert(byte_count_v == 0);
     }
 
-    char *compound::read(char *itr, const char *const itr_end)
+    std::optional<std::tuple<std::string_view, tag_type_enum, tag_variant_t>> compound::find(const std::string_view &key, tag_type_enum type_requested) noexcept
     {
-        static_assert(sizeof(tag_type_enum) == sizeof(std::byte));
-        auto itr_start = itr;
-
-        auto tag_type = static_cast<tag_type_enum>(*itr++);
-        if (static_cast<uint8_t>(tag_type) >= tag_properties.size()) [[unlikely]] throw std::runtime_error("Invalid NBT Tag Type.");
-
-        while ((itr_end - itr) >= 2 && tag_type != tag_end)
-        {
-            auto name_len = impl::read_var<uint16_t>(itr);
-
-            if ((itr + name_len + padding_size) >= itr_end)
-                [[unlikely]] throw std::runtime_error("Attempt to read past buffer while parsing binary NBT data.");
-
-            auto tag_name     = mem::pmr::make_unique<std::pmr::string>(pmr_rsrc, itr, name_len);
-            auto tag_name_ptr = tag_name.get();
-            itr += name_len;
-
-            auto create_and_insert = [this, &tag_name_ptr]<class T, class ...Args>(Args &&... args) {
-                auto tag_ptr = mem::pmr::make_unique<T>(pmr_rsrc, std::forward<Args>(args)...);
-                const auto &[_, success] = tags.insert(std::pair{ std::string_view(*tag_name_ptr), tag_ptr.get() });
-                if (!success) throw std::runtime_error("Unable to insert NBT tag to compound (possible duplicate).");
-                static_cast<void>(tag_ptr.release());
-            };
-
-            if (tag_properties[tag_type].category & (cat_compound | cat_list))
-            {
-                if (tag_type == tag_list)
-                {
-                    auto list_type = static_cast<tag_type_enum>(*itr++);
-                    if (static_cast<uint8_t>(list_type) >= tag_properties.size()) [[unlikely]] throw std::runtime_error("Invalid NBT tag type while initializing list.");
-
-                    create_and_insert.template operator()<list>(&itr, itr_end, this, std::move(tag_name), list_type);
-                }
-                else if (tag_type == tag_compound)
-                {
-                    create_and_insert.template operator()<compound>(&itr, itr_end, this, std::move(tag_name));
-                }
-            }
-            else if (tag_properties[tag_type].category == cat_primitive)
-            {
-                create_and_insert.template operator()<primitive>(tag_type, impl::read_tag_primitive(&itr, tag_type), tag_name.get());
-                static_cast<void>(tag_name.release());
-            }
-            else if (tag_properties[tag_type].category & (cat_array | cat_string))
-            {
-                if (tag_type == tag_string)
-                {
-                    auto [str_ptr, str_len] = impl::read_tag_string(&itr, itr_end, pmr_rsrc);
-                    create_and_insert.template operator()<primitive>(tag_type, std::bit_cast<uint64_t>(str_ptr.get()), tag_name.get(), static_cast<uint32_t>(str_len));
-                    static_cast<void>(tag_name.release());
-                    static_cast<void>(str_ptr.release());
-                }
-                else
-                {
-                    auto [array_ptr, array_len] = impl::read_tag_array(&itr, itr_end, tag_type, pmr_rsrc);
-                    if (array_len < 0) [[unlikely]] throw std::runtime_error("Found array with negative length while parsing binary NBT data.");
-
-                    create_and_insert.template operator()<primitive>(tag_type, std::bit_cast<uint64_t>(array_ptr.get()), tag_name.get(), static_cast<uint32_t>(array_len));
-                    static_cast<void>(tag_name.release());
-                    static_cast<void>(array_ptr.release());
-                }
-            }
-
-            tag_type = static_cast<tag_type_enum>(*itr++);
-            if (static_cast<uint8_t>(tag_type) >= tag_properties.size()) [[unlikely]] throw std::runtime_error("Invalid NBT Tag Type.");
-        }
-
-        if (tag_type != tag_end) [[unlikely]] throw std::runtime_error("NBT compound parsing ended before reaching END tag.");
+        materialize();
+        return describe_tag(tags.find(key), type_requested);
+    }
 
-        byte_count_v += itr - itr_start;
-        return itr;
+    std::optional<std::tuple<std::string_view, tag_type_enum, tag_variant_t>> compound::find(const hashed_key &key, tag_type_enum type_requested) noexcept
+    {
+        materialize();
+        return describe_tag(tags.find(key), type_requested);
     }
 
-    std::optional<std::tuple<std::string_view, tag_type_enum, tag_variant_t>> compound::find(const std::string_view &key, tag_type_enum type_requested) noexcept
+    std::optional<std::tuple<std::string_view, tag_type_enum, tag_variant_t>> compound::describe_tag(tag_list_t::iterator itr, tag_type_enum type_requested)
     {
-        auto itr = tags.find(key);
         if (itr == tags.end()) return std::nullopt;
 
         auto tag = std::visit([](auto tag) -> std::tuple<std::string_view, tag_type_enum, tag_variant_t> {
             if constexpr (std::is_same_v<decltype(tag), compound *>)
-                return std::tuple{ std::string_view(*tag->name.get()), tag_compound, tag_variant_t{ std::reference_wrapper(*tag) }};
+                return std::tuple{ tag->name.view(), tag_compound, tag_variant_t{ std::reference_wrapper(*tag) }};
             else if constexpr (std::is_same_v<decltype(tag), list *>)
-                return std::tuple{ std::string_view(*tag->name.get()), tag_list, tag_variant_t{ std::reference_wrapper(*tag) }};
+                return std::tuple{ tag->name.view(), tag_list, tag_variant_t{ std::reference_wrapper(*tag) }};
             else if constexpr (std::is_same_v<decltype(tag), primitive *>)
-                return std::tuple{ std::string_view(*tag->name), tag->type(), tag->get_generic() };
+                return std::tuple{ tag->name.view(), tag->type(), tag->get_generic() };
 
             std::unreachable();
         }, itr->second);
 
         if (type_requested != tag_end && type_requested != std::get<tag_type_enum>(tag)) return std::nullopt;
 
+        if (std::holds_alternative<primitive *>(itr->second)) mark_dirty();
         return tag;
     }
 
     compound::insert_return_type compound::insert(node_type &&node_in)
     {
-        auto tag_value = node_in.tag_node.mapped();
+        materialize();
+        if (node_in.empty()) return { iterator(tags.end()), false, std::move(node_in) };
+
+        // The node is freed through whatever this compound allocates from, so it has to have come from the same place, like with merge().
+        if (*node_in.tag_rsrc != *pmr_rsrc) throw std::runtime_error("Attempt to insert an NBT tag from a compound with a different allocator.");
+
+        auto tag_value = node_in.tag_node->second;
 
         return std::visit([this, &node_in](auto tag) -> insert_return_type  {
             if constexpr (!std::is_same_v<std::remove_reference_t<decltype(tag)>, primitive *>)
@@ -238,7 +259,16 @@ namespace melon::nbt
 
             try
             {
-                auto [pos, success, handle] = tags.insert(std::move(node_in.tag_node));
+                auto [pos, success] = tags.insert(*node_in.tag_node);
+
+                if (!success)
+                {
+                    this->adjust_byte_count(tag->bytes() * -1);
+                    return { iterator(pos), false, std::move(node_in) };
+                }
+
+                node_in.tag_node.reset();
+                node_in.tag_rsrc = nullptr;
 
                 if constexpr (!std::is_same_v<std::remove_reference_t<decltype(tag)>, primitive *>)
                     tag->change_properties({ .new_depth = this->depth + 1, .new_parent = this, .new_top = this->top });
@@ -257,9 +287,22 @@ namespace melon::nbt
     {
         if (pos != cend())
         {
-            auto tag_node    = tags.extract(pos.itr);
-            auto tag_value   = tag_node.mapped();
-            auto node_handle = compound_node_handle(std::move(tag_node));
+            // Anything borrowed from the raw buffer or name pool of this tree has to be copied out before it leaves, as they stay with the tree.
+            if (top->borrows || top->interns)
+            {
+                std::visit([this](auto tag) {
+                    if constexpr (std::is_same_v<std::remove_reference_t<decltype(tag)>, primitive *>)
+                        tag->copy_borrowed(pmr_rsrc);
+                    else
+                        tag->copy_borrowed();
+                }, pos.itr->second);
+            }
+
+            auto tag_value = pos.itr->second;
+            auto tag_key   = std::visit([](auto tag) { return tag->name.view(); }, tag_value);
+
+            auto node_handle = compound_node_handle(std::pair{ tag_key, tag_value }, tags.get_allocator());
+            tags.erase(pos.itr);
 
             std::visit([this](auto tag) {
                 // This is the only way to get a list with null top and parent members. Such a list is not in a complete state until it is
@@ -281,7 +324,19 @@ namespace melon::nbt
 
     compound::node_type compound::extract(const std::string_view &key, tag_type_enum type_requested)
     {
-        const auto itr = const_iterator(tags.find(key));
+        materialize();
+        return extract_tag(tags.find(key), type_requested);
+    }
+
+    compound::node_type compound::extract(const hashed_key &key, tag_type_enum type_requested)
+    {
+        materialize();
+        return extract_tag(tags.find(key), type_requested);
+    }
+
+    compound::node_type compound::extract_tag(tag_list_t::iterator found, tag_type_enum type_requested)
+    {
+        const auto itr = const_iterator(found);
 
         if (itr != cend())
         {
@@ -296,9 +351,11 @@ namespace melon::nbt
 
     void compound::to_snbt(std::string &out)
     {
-        if (name != nullptr && !name->empty())
+        materialize();
+
+        if (!name.empty())
         {
-            snbt::escape_string(*name, out, false);
+            snbt::escape_string(name, out, false);
             out.push_back(':');
         }
 
@@ -308,7 +365,7 @@ namespace melon::nbt
         for (const auto &[_, tag]: tags)
         {
             std::visit([&processed_count, &out](auto &&tag_in) {
-                if (tag_in->name == nullptr || tag_in->name->empty()) [[unlikely]] throw std::runtime_error("Unexpected anonymous tag in NBT compound.");
+                if (tag_in->name.empty()) [[unlikely]] throw std::runtime_error("Unexpected anonymous tag in NBT compound.");
 
                 tag_in->to_snbt(out);
                 out.push_back(',');
@@ -330,75 +387,418 @@ namespace melon::nbt
         return out;
     }
 
+    namespace
+    {
+        char *write_tag_header(char *itr, tag_type_enum tag_type, std::string_view tag_name)
+        {
+            *itr = static_cast<int8_t>(tag_type);
+            itr++;
+
+            auto len = util::cvt_endian<std::endian::little, std::endian::big>(static_cast<uint16_t>(tag_name.size()));
+
+            std::memcpy(itr, &len, sizeof(decltype(len)));
+            itr += sizeof(decltype(len));
+
+            if (!tag_name.empty()) std::memcpy(itr, tag_name.data(), tag_name.size()); // NOLINT(bugprone-not-null-terminated-result)
+            return itr + tag_name.size();
+        }
+
+        tag_type_enum tag_type_of(const std::variant<compound *, list *, primitive *> &tag)
+        {
+            return std::visit([](auto &&tag_ptr) {
+                if constexpr (std::is_same_v<std::decay_t<decltype(tag_ptr)>, compound *>)
+                    return tag_compound;
+                else if constexpr (std::is_same_v<std::decay_t<decltype(tag_ptr)>, list *>)
+                    return tag_list;
+                else
+                    return tag_ptr->type();
+            }, tag);
+        }
+    }
+
     std::pair<std::unique_ptr<char[]>, size_t> compound::to_binary()
     {
         auto raw_ptr = std::make_unique<char[]>(bytes() + padding_size);
-        auto raw_buf = raw_ptr.get();
+        auto written = to_binary(std::span(raw_ptr.get(), bytes()));
+
+        return { std::move(raw_ptr), written };
+    }
+
+    size_t compound::to_binary(std::span<char> out)
+    {
+        if (out.size() < bytes()) throw std::runtime_error("Buffer too small to serialize NBT compound to binary.");
+
+        to_binary(write_tag_header(out.data(), tag_compound, name.view()));
+        return bytes();
+    }
+
+    std::pair<std::unique_ptr<char[], mem::pmr::array_deleter<char[]>>, size_t> compound::to_binary(const allocator_type &alloc)
+    {
+        auto raw_ptr = mem::pmr::make_unique<char[]>(alloc.resource(), bytes() + padding_size);
+        auto written = to_binary(std::span(raw_ptr.get(), bytes()));
+
+        return { std::move(raw_ptr), written };
+    }
+
+    void compound::to_binary(std::span<char> scratch, const std::function<void(std::span<const char>)> &sink)
+    {
+        if (scratch.size() < binary_scratch_min) throw std::runtime_error("Scratch buffer too small to serialize NBT compound to binary.");
+
+        binary_sink out(scratch, sink);
+
+        out.write_header(tag_compound, name.view());
+        write_binary(out, this, bytes() - (sizeof(int8_t) + sizeof(uint16_t) + name.size()));
+        out.flush();
+    }
+
+    char *compound::binary_sink::reserve(size_t bytes)
+    {
+        if (bytes > scratch.size()) return nullptr;
+        if (bytes > scratch.size() - used) flush();
+
+        auto dst = scratch.data() + used;
+        used += bytes;
+
+        return dst;
+    }
+
+    void compound::binary_sink::write(const void *src, size_t bytes)
+    {
+        auto src_itr = static_cast<const char *>(src);
+
+        while (bytes > 0)
+        {
+            if (used == scratch.size()) flush();
+
+            auto piece = std::min(bytes, scratch.size() - used);
+            std::memcpy(scratch.data() + used, src_itr, piece);
+
+            used += piece;
+            src_itr += piece;
+            bytes -= piece;
+        }
+    }
+
+    void compound::binary_sink::write_big_endian(const void *src, size_t count, size_t elem_size)
+    {
+        auto src_itr = static_cast<const char *>(src);
+
+        while (count > 0)
+        {
+            if (scratch.size() - used < elem_size) flush();
+
+            auto piece = std::min(count, (scratch.size() - used) / elem_size);
+            util::cvt_endian_array<std::endian::native, std::endian::big>(scratch.data() + used, src_itr, piece, elem_size);
+
+            used += piece * elem_size;
+            src_itr += piece * elem_size;
+            count -= piece;
+        }
+    }
+
+    void compound::binary_sink::write_header(tag_type_enum tag_type, std::string_view tag_name)
+    {
+        if (auto dst = reserve(sizeof(int8_t) + sizeof(uint16_t) + tag_name.size()))
+        {
+            write_tag_header(dst, tag_type, tag_name);
+            return;
+        }
+
+        // Only a name longer than scratch gets here.
+        auto len = util::cvt_endian<std::endian::little, std::endian::big>(static_cast<uint16_t>(tag_name.size()));
+
+        write(&tag_type, sizeof(tag_type));
+        write(&len, sizeof(len));
+        write(tag_name.data(), tag_name.size());
+    }
+
+    void compound::binary_sink::flush()
+    {
+        if (used == 0) return;
+
+        sink(scratch.first(used));
+        used = 0;
+    }
+
+    // Writes the payload of a tag, everything to_binary(char *) would write for it, which is bytes long.
+    void compound::write_binary(binary_sink &out, const std::variant<compound *, list *, primitive *> &tag, size_t bytes)
+    {
+        if (auto dst = out.reserve(bytes))
+        {
+            [[maybe_unused]] auto end = std::visit([dst](auto &&tag_ptr) { return tag_ptr->to_binary(dst); }, tag);
+            assert(end == dst + bytes);
+            return;
+        }
+
+        if (auto container = std::get_if<compound *>(&tag))
+        {
+            auto target = *container;
 
-        *raw_buf = static_cast<int8_t>(tag_compound);
-        raw_buf++;
+            if (auto range = target->original(); !range.empty())
+            {
+                out.write(range.data(), range.size());
+                return;
+            }
+
+            for (auto &[tag_key, tag_variant]: target->tags)
+            {
+                if (tag_key.empty()) throw std::runtime_error("Found tag with no name while serializing NBT compound to binary.");
+
+                out.write_header(tag_type_of(tag_variant), tag_key);
+                write_binary(out, tag_variant, std::visit([](auto &&tag_ptr) { return tag_ptr->bytes(); }, tag_variant) -
+                                               (sizeof(int8_t) + sizeof(uint16_t) + tag_key.size()));
+            }
 
-        if (name != nullptr && !name->empty())
+            auto end_tag = static_cast<int8_t>(tag_end);
+            out.write(&end_tag, sizeof(end_tag));
+        }
+        else if (auto container = std::get_if<list *>(&tag))
         {
-            auto len = util::cvt_endian<std::endian::little, std::endian::big>(static_cast<uint16_t>(name->size()));
+            auto target    = *container;
+            auto list_type = static_cast<int8_t>(target->type());
 
-            std::memcpy(raw_buf, &len, sizeof(decltype(len)));
-            raw_buf += sizeof(decltype(len));
+            if (target->size() == 0 || target->type() == tag_end)
+            {
+                std::array<char, sizeof(int8_t) + sizeof(int32_t)> empty{ };
+                out.write(empty.data(), empty.size());
+                return;
+            }
 
-            std::memcpy(raw_buf, name->data(), name->size()); // NOLINT(bugprone-not-null-terminated-result)
-            raw_buf += name->size();
+            out.write(&list_type, sizeof(list_type));
+
+            if (auto range = target->original(); !range.empty())
+            {
+                out.write(range.data(), range.size());
+                return;
+            }
+
+            auto count = util::cvt_endian<std::endian::little, std::endian::big>(static_cast<int32_t>(target->size()));
+            out.write(&count, sizeof(count));
+
+            if (target->is_packed())
+                out.write_big_endian(target->packed_v, target->packed_count, tag_properties[target->type()].size);
+            else
+            {
+                for (auto element: target->tags)
+                {
+                    if (target->type() == tag_compound)
+                        write_binary(out, static_cast<compound *>(element), static_cast<compound *>(element)->bytes());
+                    else if (target->type() == tag_list)
+                        write_binary(out, static_cast<list *>(element), static_cast<list *>(element)->bytes());
+                    else
+                        write_binary(out, static_cast<primitive *>(element), static_cast<primitive *>(element)->bytes({ .full_tag = false }));
+                }
+            }
         }
         else
         {
-            uint16_t len = 0;
+            // Fixed size primitives always fit in scratch, so this is a long string or array.
+            auto value     = std::get<primitive *>(tag);
+            auto elem_size = tag_properties[value->type()].size;
+
+            if (value->type() == tag_string)
+            {
+                auto len = util::cvt_endian<std::endian::little, std::endian::big>(static_cast<uint16_t>(value->size()));
+
+                out.write(&len, sizeof(len));
+                out.write(value->value.tag_string, value->size());
+            }
+            else
+            {
+                auto len = util::cvt_endian<std::endian::little, std::endian::big>(static_cast<int32_t>(value->size()));
 
-            std::memcpy(raw_buf, &len, sizeof(decltype(len)));
-            raw_buf += sizeof(decltype(len));
+                out.write(&len, sizeof(len));
+                out.write_big_endian(value->value.generic_ptr, value->size(), elem_size);
+            }
         }
+    }
+
+    std::pair<std::unique_ptr<char[]>, size_t> compound::to_binary_parallel(unsigned threads)
+    {
+        auto raw_ptr = std::make_unique<char[]>(bytes() + padding_size);
+        auto raw_buf = write_tag_header(raw_ptr.get(), tag_compound, name.view());
+
+        if (!original().empty() || bytes() < binary_run_bytes)
+        {
+            to_binary(raw_buf);
+            return { std::move(raw_ptr), bytes() };
+        }
+
+        std::vector<binary_run> runs;
+        [[maybe_unused]] auto end = plan_binary(raw_buf, runs);
+        assert(end == raw_ptr.get() + bytes());
+
+        // Biggest first, so a long run isn't left to start after everything else has finished.
+        std::ranges::sort(runs, std::ranges::greater(), &binary_run::bytes);
+
+        util::run_parallel(runs.size(), threads, [&runs](size_t idx) {
+            auto &run = runs[idx];
+            char *itr;
+
+            if (auto entries = std::get_if<0>(&run.tags))
+                itr = write_entries(run.dst, *entries);
+            else
+            {
+                auto &[element_type, elements] = std::get<1>(run.tags);
+                itr = run.dst;
+
+                for (auto element: elements)
+                    itr = element_type == tag_compound ? static_cast<compound *>(element)->to_binary(itr) : static_cast<list *>(element)->to_binary(itr);
+            }
+
+            if (itr != run.dst + run.bytes) [[unlikely]] throw std::runtime_error("NBT tag size out of step with its contents while serializing to binary.");
+        });
 
-        to_binary(raw_buf);
         return { std::move(raw_ptr), bytes() };
     }
 
     char *compound::to_binary(char *itr)
     {
-        for (const auto &[tag_key, tag_variant] : tags)
+        // An unparsed or unchanged compound is still exactly what it was in the raw buffer.
+        if (auto range = original(); !range.empty())
         {
-            auto &key = tag_key;
-            std::visit([&key, &itr](auto &tag) {
-                if constexpr (std::is_same_v<std::decay_t<decltype(tag)>, compound *>)
-                    *itr = static_cast<int8_t>(tag_compound);
-                else if constexpr (std::is_same_v<std::decay_t<decltype(tag)>, list *>)
-                    *itr = static_cast<int8_t>(tag_list);
-                else
-                    *itr = static_cast<int8_t>(tag->type());
+            std::memcpy(itr, range.data(), range.size());
+            return itr + range.size();
+        }
 
-                itr++;
+        itr = write_entries(itr, { tags.begin(), tags.end() });
 
-                if (!key.empty())
-                {
-                    auto len = util::cvt_endian<std::endian::little, std::endian::big>(static_cast<uint16_t>(key.size()));
+        *itr = static_cast<int8_t>(tag_end);
+        return ++itr;
+    }
 
-                    std::memcpy(itr, &len, sizeof(decltype(len)));
-                    itr += sizeof(decltype(len));
+    char *compound::write_entries(char *itr, std::span<tag_list_t::value_type> entries)
+    {
+        for (auto &[tag_key, tag_variant]: entries)
+        {
+            if (tag_key.empty()) throw std::runtime_error("Found tag with no name while serializing NBT compound to binary.");
 
-                    std::memcpy(itr, key.data(), key.size()); // NOLINT(bugprone-not-null-terminated-result)
-                    itr += key.size();
-                }
+            itr = write_tag_header(itr, tag_type_of(tag_variant), tag_key);
+            itr = std::visit([itr](auto &tag) { return tag->to_binary(itr); }, tag_variant);
+        }
+
+        return itr;
+    }
+
+    // Whether a tag is worth cutting into runs rather than being written whole by one thread.
+    bool compound::binary_splits(const std::variant<compound *, list *, primitive *> &tag)
+    {
+        return std::visit([](auto &&tag_ptr) {
+            using tag_ptr_t = std::decay_t<decltype(tag_ptr)>;
+
+            if constexpr (std::is_same_v<tag_ptr_t, compound *>)
+                return tag_ptr->original().empty() && tag_ptr->bytes() >= binary_run_bytes;
+            else if constexpr (std::is_same_v<tag_ptr_t, list *>)
+                return tag_ptr->original().empty() && !tag_ptr->is_packed() && (tag_ptr->type() == tag_compound || tag_ptr->type() == tag_list) &&
+                       tag_ptr->size() > 0 && tag_ptr->bytes() >= binary_run_bytes;
+            else
+                return false;
+        }, tag);
+    }
+
+    // Writes the framing of this compound at itr, along with any tags that split further, and leaves the rest to runs. Returns the end of the
+    // compound, the same place to_binary(itr) would have.
+    char *compound::plan_binary(char *itr, std::vector<binary_run> &runs)
+    {
+        auto run_first = tags.begin();
+        auto run_dst   = itr;
+
+        auto end_run = [&](tag_list_t::iterator last) {
+            if (last != run_first) runs.push_back({ .dst = run_dst, .bytes = static_cast<size_t>(itr - run_dst), .tags = std::span(run_first, last) });
+
+            run_first = last;
+            run_dst   = itr;
+        };
+
+        for (auto tag_itr = tags.begin(); tag_itr != tags.end(); tag_itr++)
+        {
+            auto &[tag_key, tag_variant] = *tag_itr;
+
+            if (binary_splits(tag_variant))
+            {
+                end_run(tag_itr);
+
+                if (tag_key.empty()) throw std::runtime_error("Found tag with no name while serializing NBT compound to binary.");
+                itr = write_tag_header(itr, tag_type_of(tag_variant), tag_key);
+
+                if (auto child = std::get_if<compound *>(&tag_variant))
+                    itr = (*child)->plan_binary(itr, runs);
                 else
-                    throw std::runtime_error("Found tag with no name while serializing NBT compound to binary.");
+                    itr = plan_binary(*std::get<list *>(tag_variant), itr, runs);
 
-                itr = tag->to_binary(itr);
-            }, tag_variant);
+                run_first = tag_itr + 1;
+                run_dst   = itr;
+            }
+            else
+            {
+                itr += std::visit([](auto &&tag) { return tag->bytes(); }, tag_variant);
+                if (static_cast<size_t>(itr - run_dst) >= binary_run_bytes) end_run(tag_itr + 1);
+            }
         }
 
+        end_run(tags.end());
+
         *itr = static_cast<int8_t>(tag_end);
         return ++itr;
     }
 
-    std::pair<mem::pmr::unique_ptr<std::pmr::string>, mem::pmr::unique_ptr<primitive>>
-    compound::new_primitive(std::string_view tag_name, tag_type_enum tag_type, bool overwrite)
+    // The same as above for a list, which only gets here when it holds compounds or lists.
+    char *compound::plan_binary(list &target, char *itr, std::vector<binary_run> &runs)
     {
+        auto element_type = target.type();
+
+        *itr = static_cast<int8_t>(element_type);
+        itr++;
+
+        auto count = util::cvt_endian<std::endian::little, std::endian::big>(static_cast<int32_t>(target.size()));
+        std::memcpy(itr, &count, sizeof(decltype(count)));
+        itr += sizeof(decltype(count));
+
+        size_t run_first = 0;
+        auto   run_dst   = itr;
+
+        auto end_run = [&](size_t last) {
+            if (last != run_first)
+                runs.push_back({ .dst = run_dst, .bytes = static_cast<size_t>(itr - run_dst), .tags = std::pair{ element_type, std::span(target.tags).subspan(run_first, last - run_first) }});
+
+            run_first = last;
+            run_dst   = itr;
+        };
+
+        for (size_t idx = 0; idx < target.tags.size(); idx++)
+        {
+            std::variant<compound *, list *, primitive *> element;
+            if (element_type == tag_compound)
+                element = static_cast<compound *>(target.tags[idx]);
+            else
+                element = static_cast<list *>(target.tags[idx]);
+
+            if (binary_splits(element))
+            {
+                end_run(idx);
+
+                if (auto child = std::get_if<compound *>(&element))
+                    itr = (*child)->plan_binary(itr, runs);
+                else
+                    itr = plan_binary(*std::get<list *>(element), itr, runs);
+
+                run_first = idx + 1;
+                run_dst   = itr;
+            }
+            else
+            {
+                itr += std::visit([](auto &&tag) { return tag->bytes(); }, element);
+                if (static_cast<size_t>(itr - run_dst) >= binary_run_bytes) end_run(idx + 1);
+            }
+        }
+
+        end_run(target.tags.size());
+        return itr;
+    }
+
+    std::unique_ptr<primitive, primitive_deleter> compound::new_primitive(std::string_view tag_name, tag_type_enum tag_type, bool overwrite, int32_t embed_len)
+    {
+        materialize();
         const auto &itr = tags.find(tag_name);
 
         if (itr != tags.end())
@@ -409,10 +809,9 @@ namespace melon::nbt
                 throw std::runtime_error("Attempted to insert over existing key in NBT compound.");
         }
 
-        auto str_ptr = mem::pmr::make_unique<std::pmr::string>(pmr_rsrc, tag_name);
-        auto tag_ptr = mem::pmr::make_unique<primitive>(pmr_rsrc, tag_type, 0, str_ptr.get());
+        if (tag_name.size() > std::numeric_limits<uint16_t>::max()) [[unlikely]] throw std::runtime_error("NBT tag name too long.");
 
-        return { std::move(str_ptr), std::move(tag_ptr) };
+        return { primitive::make(pmr_rsrc, tag_type, { .embed_name = tag_name, .embed_len = embed_len }), { pmr_rsrc }};
     }
 
     // Circular dependency hell
@@ -424,7 +823,17 @@ namespace melon::nbt
         try
         {
             if (builder) builder(*container);
-            tags.insert(itr.itr, static_cast<void *>(container.get()));
+            if (indexes != nullptr) index_added(*container);
+
+            try
+            {
+                tags.insert(tags.begin() + itr.idx, static_cast<void *>(container.get()));
+            }
+            catch (...)
+            {
+                index_removed(*container);
+                throw;
+            }
         } catch (...)
         {
             adjust_byte_count(container->bytes() * -1);
@@ -440,6 +849,9 @@ namespace melon::nbt
     {
         if (*src.pmr_rsrc != *this->pmr_rsrc) throw std::runtime_error("Attempt to merge NBT compounds with different allocators.");
 
+        materialize();
+        src.materialize();
+
         // Perform a first pass to check depth and size
         int64_t new_size  = 0;
         size_t new_count = 0;
@@ -465,11 +877,21 @@ namespace melon::nbt
             if (!contains(itr->first))
             {
                 std::visit([this, &src, &itr](auto tag) {
+                    // Borrowed names and values have to be copied out of the source tree's raw buffer first. Both copies are equally valid until
+                    // the tag is moved, so failing here leaves the tag where it was.
+                    if (src.top->borrows || src.top->interns)
+                    {
+                        if constexpr (std::is_same_v<primitive *, std::remove_reference_t<decltype(tag)>>)
+                            tag->copy_borrowed(pmr_rsrc);
+                        else
+                            tag->copy_borrowed();
+                    }
+
                     adjust_byte_count(tag->bytes()); // Shouldn't throw due to check above
 
                     // This would be possible with an extract and an insert, but we could lose elements mid-flight if an exception is thrown.
                     // Instead, do this in a transactional fashion. We're only copying a short string and a pointer here, so it should be fine.
-                    const auto &[_, success] = tags.insert(std::pair{ std::string_view(*tag->name), tag }); // Really can't think of why this would throw at this point...
+                    const auto &[_, success] = tags.insert(std::pair{ tag->name.view(), tag }); // Really can't think of why this would throw at this point...
 
                     if (success)
                     {
@@ -490,6 +912,7 @@ namespace melon::nbt
 
     uint16_t compound::get_tree_depth()
     {
+        materialize();
         uint16_t ret = depth;
 
         for (auto itr: tags)
@@ -534,8 +957,83 @@ namespace melon::nbt
         }
     }
 
+    void compound::copy_borrowed()
+    {
+        materialize();
+        name.make_owned(pmr_rsrc);
+
+        for (auto &[_, tag]: tags)
+        {
+            std::visit([this](auto tag_ptr) {
+                if constexpr (std::is_same_v<primitive *, std::remove_reference_t<decltype(tag_ptr)>>)
+                    tag_ptr->copy_borrowed(pmr_rsrc);
+                else
+                    tag_ptr->copy_borrowed();
+            }, tag);
+        }
+
+        // Keys still point at the old names, which remain valid until the raw buffer goes away. The new names hash the same, so the keys can
+        // be pointed at them in place.
+        for (auto &[tag_key, tag]: tags)
+            tag_key = std::visit([](auto tag_ptr) { return tag_ptr->name.view(); }, tag);
+
+        // The buffer the clean range is in goes away with the tree it's left.
+        clean_begin = nullptr;
+
+        if (state != nullptr)
+        {
+            state->raw.reset();
+            state->own_names.reset();
+            if (interns) state->names = nullptr;
+        }
+
+        borrows = false;
+        interns = false;
+    }
+
+    void compound::read_lazy()
+    {
+        auto range_begin      = std::exchange(lazy_begin, nullptr);
+        auto byte_count_saved = byte_count_v;
+
+        // The parser counts the range again as it goes.
+        byte_count_v -= lazy_end - range_begin;
+
+        try
+        {
+            // The range was checked when it was skipped over, and the buffer is padded past its end.
+            parser::read(*this, range_begin, lazy_end + padding_size + 1);
+        }
+        catch (...)
+        {
+            // Unwind without touching the byte counts of our parents, which never saw the partially read tags.
+            auto parent_saved = std::exchange(parent, static_cast<compound *>(nullptr));
+            clear();
+            parent = parent_saved;
+
+            byte_count_v = byte_count_saved;
+            lazy_begin   = range_begin;
+            throw;
+        }
+    }
+
     size_t compound::erase(std::string_view &&key)
     {
+        materialize();
+        auto itr = tags.find(key);
+
+        if (itr != tags.end())
+        {
+            erase(iterator(itr));
+            return 1;
+        }
+        else
+            return 0;
+    }
+
+    size_t compound::erase(const hashed_key &key)
+    {
+        materialize();
         auto itr = tags.find(key);
 
         if (itr != tags.end())
@@ -557,6 +1055,16 @@ namespace melon::nbt
 
         // Only adjust size after all recursive checks to allow strong exception guarantee.
         byte_count_v += by;
+        clean_begin = nullptr;
+    }
+
+    void compound::forget_clean() noexcept
+    {
+        clean_begin = nullptr;
+
+        std::visit([](auto &&tag) {
+            if (tag != nullptr) tag->mark_dirty();
+        }, parent);
     }
 
     compound::tag_list_t::iterator compound::destroy_tag(const tag_list_t::iterator &itr)
@@ -575,25 +1083,26 @@ namespace melon::nbt
             if constexpr (std::is_same_v<decltype(tag_ptr), primitive *>)
             {
                 this->adjust_byte_count(static_cast<int64_t>(tag_ptr->bytes()) * -1);
-
-                if (tag_ptr->name != nullptr)
-                {
-                    std::destroy_at(tag_ptr->name);
-                    pmr_rsrc->deallocate(tag_ptr->name, sizeof(std::remove_pointer_t<decltype(tag_ptr->name)>), alignof(std::remove_pointer_t<decltype(tag_ptr->name)>));
-                }
-
-                if (tag_properties[tag_ptr->type()].category & (cat_array | cat_string) && tag_ptr->value.generic_ptr != nullptr)
-                    pmr_rsrc->deallocate(tag_ptr->value.generic_ptr, tag_ptr->size() * tag_properties[tag_ptr->type()].size + padding_size,
-                                         tag_properties[tag_ptr->type()].size);
+                primitive::destroy(tag_ptr, pmr_rsrc);
+            }
+            else
+            {
+                std::destroy_at(tag_ptr);
+                pmr_rsrc->deallocate(tag_ptr, sizeof(std::remove_pointer_t<decltype(tag_ptr)>), alignof(std::remove_pointer_t<decltype(tag_ptr)>));
             }
-
-            std::destroy_at(tag_ptr);
-            pmr_rsrc->deallocate(tag_ptr, sizeof(std::remove_pointer_t<decltype(tag_ptr)>), alignof(std::remove_pointer_t<decltype(tag_ptr)>));
         }, tag_variant);
     }
 
     void compound::clear()
     {
+        if (lazy_begin != nullptr)
+        {
+            // Nothing was parsed, so there is nothing to free. Forget the range, leaving only its END tag counted.
+            adjust_byte_count((lazy_end - lazy_begin - sizeof(int8_t)) * -1);
+            lazy_begin = nullptr;
+            return;
+        }
+
         auto itr = tags.begin();
         while (itr != tags.end())
         {
@@ -5,13 +5,17 @@
 #ifndef MELON_NBT_COMPOUND_H
 #define MELON_NBT_COMPOUND_H
 
-#include <unordered_map>
+#include <memory_resource>
 #include <utility>
 #include <functional>
+#include <span>
+#include <vector>
 #include "primitive.h"
+#include "name_pool.h"
+#include "tag_map.h"
 #include "impl.h"
+#include "parser.h"
 
-// TODO: Add SNBT parsing
 // TODO: Region file support
 // TODO: Const iterator for list, maybe?
 // TODO: Doxygen?
@@ -20,11 +24,20 @@ namespace melon::nbt
 {
     class list;
 
+    // Picks the compound constructor that scans its buffer up front and parses into one arena sized for the whole tree.
+    struct exact_arena_t
+    {
+        explicit exact_arena_t() = default;
+    };
+
+    inline constexpr exact_arena_t exact_arena{ };
+
     class compound
     {
     public:
         using allocator_type = std::pmr::polymorphic_allocator<>;
-        using tag_list_t = std::pmr::unordered_map<std::string_view, std::variant<compound *, list *, primitive *>>;
+        // Up to 8 tags are kept inline and searched linearly, past that they move to a dense hash map. See tag_map for what invalidates iterators.
+        using tag_list_t = tag_map<std::variant<compound *, list *, primitive *>>;
 
         // @formatter:off
         class iterator
@@ -32,7 +45,7 @@ namespace melon::nbt
             friend class compound;
 
             tag_list_t::iterator itr;
-            using itr_value = tag_list_t::iterator::value_type;
+            using itr_value = tag_list_t::value_type;
         public:
             using value_type = std::tuple<std::string_view, tag_type_enum, tag_variant_t>;
             using difference_type = int;
@@ -58,7 +71,7 @@ namespace melon::nbt
             friend class compound;
 
             tag_list_t::const_iterator itr;
-            using itr_value = tag_list_t::const_iterator::value_type;
+            using itr_value = tag_list_t::value_type;
         public:
             using value_type = std::tuple<const std::string_view, const tag_type_enum, const tag_variant_t>;
             using difference_type = int;
@@ -83,57 +96,69 @@ namespace melon::nbt
         };
         //@formatter:on
 
+        // The tag map has no nodes to hand out, so a handle holds the extracted key and tag itself. It still owns the tag in the same way.
         class compound_node_handle
         {
             friend class compound;
 
-            compound::tag_list_t::node_type tag_node{ };
+            using node_value_type = compound::tag_list_t::value_type;
+            using node_allocator_type = compound::tag_list_t::allocator_type;
 
-            explicit compound_node_handle(compound::tag_list_t::node_type &&tag_node_in)
-                    : tag_node(std::move(tag_node_in))
+            // Like a standard node handle, key() gives out a mutable key even from a const handle.
+            mutable std::optional<node_value_type> tag_node{ };
+            std::pmr::memory_resource              *tag_rsrc = nullptr;
+
+            explicit compound_node_handle(node_value_type &&tag_node_in, const node_allocator_type &alloc_in)
+                    : tag_node(std::move(tag_node_in)),
+                      tag_rsrc(alloc_in.resource())
             { }
 
         public:
-            using allocator_type = compound::tag_list_t::node_type::allocator_type;
-            using key_type = compound::tag_list_t::node_type::key_type;
+            using allocator_type = node_allocator_type;
+            using key_type = compound::tag_list_t::key_type;
             using mapped_type = tag_variant_t;
 
             compound_node_handle() noexcept = default;
             compound_node_handle(compound_node_handle &node_in) = delete;
 
             compound_node_handle(compound_node_handle &&node_in) noexcept
-                    : tag_node(std::move(node_in.tag_node))
+                    : tag_node(std::exchange(node_in.tag_node, std::nullopt)),
+                      tag_rsrc(std::exchange(node_in.tag_rsrc, nullptr))
             { }
 
             compound_node_handle &operator=(compound_node_handle &&node_in) noexcept
             {
-                tag_node = std::move(node_in.tag_node);
+                tag_node  = std::exchange(node_in.tag_node, std::nullopt);
+                tag_rsrc = std::exchange(node_in.tag_rsrc, nullptr);
                 return *this;
             }
 
             ~compound_node_handle() = default;
 
             [[nodiscard]] bool empty() const noexcept
-            { return tag_node.empty(); }
+            { return !tag_node.has_value(); }
 
             explicit operator bool() const noexcept
-            { return !tag_node.empty(); }
+            { return tag_node.has_value(); }
 
             [[nodiscard]] allocator_type get_allocator() const
-            { return tag_node.get_allocator(); }
+            {
+                if (tag_rsrc == nullptr) [[unlikely]] throw std::bad_optional_access();
+                return allocator_type(tag_rsrc);
+            }
 
             [[nodiscard]] key_type &key() const
-            { return tag_node.key(); }
+            { return tag_node->first; }
 
             [[nodiscard]] mapped_type mapped() const
             {
-                if (std::holds_alternative<compound *>(tag_node.mapped()))
-                    return std::reference_wrapper<compound>(*std::get<compound *>(tag_node.mapped()));
-                else if (std::holds_alternative<list *>(tag_node.mapped()))
-                    return std::reference_wrapper<list>(*std::get<list *>(tag_node.mapped()));
-                else if (std::holds_alternative<primitive *>(tag_node.mapped()))
+                if (std::holds_alternative<compound *>(tag_node->second))
+                    return std::reference_wrapper<compound>(*std::get<compound *>(tag_node->second));
+                else if (std::holds_alternative<list *>(tag_node->second))
+                    return std::reference_wrapper<list>(*std::get<list *>(tag_node->second));
+                else if (std::holds_alternative<primitive *>(tag_node->second))
                 {
-                    auto prim_ptr = std::get<primitive *>(tag_node.mapped());
+                    auto prim_ptr = std::get<primitive *>(tag_node->second);
                     return prim_ptr->get_generic();
                 }
                 else
@@ -141,7 +166,10 @@ namespace melon::nbt
             }
 
             void swap(compound_node_handle &node_in) noexcept
-            { return tag_node.swap(node_in.tag_node); }
+            {
+                std::swap(tag_node, node_in.tag_node);
+                std::swap(tag_rsrc, node_in.tag_rsrc);
+            }
 
             friend void swap(compound_node_handle &x, compound_node_handle &y) noexcept
             { x.swap(y); }
@@ -163,8 +191,79 @@ namespace melon::nbt
             bool overwrite = false;
         };
 
+        struct parse_args : util::forced_named_init<parse_args>
+        {
+            // Keep the raw buffer alive for the lifetime of the tree, and point names and string/byte array values into it instead of copying
+            // them. Anything borrowed is copied out if it leaves the tree through extract() or merge().
+            //
+            // A tree that keeps its buffer also remembers where each compound and list was read from, and serializing it copies those that
+            // haven't changed since straight out of the buffer instead of encoding them tag by tag.
+            bool borrow_buffer = false;
+
+            // Only record nested compounds and lists as a range of the raw buffer, and parse them the first time they're used. Implies
+            // borrow_buffer, as the buffer has to be kept either way.
+            //
+            // find() stays noexcept, so if a compound can't be parsed the first time it's found (it runs out of memory, or repeats a name,
+            // which the first pass doesn't check for), the program terminates. Calling size() on it first throws instead.
+            bool lazy = false;
+
+            // Keep one copy of each distinct name for the whole tree in a name_pool, instead of one per tag. Interned names are copied out
+            // like borrowed ones if they leave the tree. Names borrowed from the raw buffer are used over interned ones, as they cost nothing.
+            bool intern_names = false;
+
+            // Intern names in this pool instead of one made for the tree, so a batch of trees can share it. The pool has to outlive every tree
+            // parsed with it, and anything extracted from them. Implies intern_names.
+            name_pool *names = nullptr;
+
+            // Read the elements of lists of compounds or lists on up to this many threads, 0 for one per core. Element boundaries are found
+            // with a skip-only scan first, then runs of elements are parsed concurrently. The tree allocates through a synchronized pool it
+            // owns, upstream of the allocator passed in, so the threads mostly allocate from pools of their own. Ignored in lazy mode, with
+            // interned names, with exact_arena, and when it comes to a single thread, all of which parse on the calling thread.
+            //
+            // As the pool belongs to the tree, so does everything allocated from it. A node extracted from the tree can only be inserted back
+            // into it (anywhere else throws), and mustn't be kept past the root.
+            unsigned threads = 1;
+        };
+
+        // The arena and its initial buffer share one allocation from upstream.
+        struct arena_deleter
+        {
+            std::pmr::memory_resource *upstream;
+            size_t                    bytes;
+
+            void operator()(std::pmr::monotonic_buffer_resource *ptr) const noexcept;
+        };
+
+        using arena_ptr = std::unique_ptr<std::pmr::monotonic_buffer_resource, arena_deleter>;
+
+        // What a tree parsed from a buffer keeps for as long as it lives. Only a compound that was parsed as the top of a tree has one, and it
+        // keeps it if it's inserted into another tree, as names and values below it may still borrow from it.
+        struct tree_state
+        {
+            // Only set with exact_arena. Declared ahead of everything else so it's destroyed last.
+            arena_ptr arena;
+
+            // Only set when parsing on more than one thread.
+            std::unique_ptr<std::pmr::synchronized_pool_resource> shared_pool;
+
+            // Only set when parsing in borrowing mode. Names and values below may point into this buffer.
+            std::unique_ptr<char[]> raw;
+
+            // Only set when parsing with intern_names and no shared pool. Names below may point into this pool.
+            std::unique_ptr<name_pool> own_names;
+
+            // The pool names are interned in, if they are.
+            name_pool *names = nullptr;
+
+            // Set in lazy mode, so nested containers are skipped over instead of read.
+            bool lazy = false;
+        };
+
         std::variant<compound *, list *> parent;
         compound                         *top;
+
+        // Declared ahead of everything that may be allocated from its arena or pool, so it's destroyed last.
+        std::unique_ptr<tree_state>      state;
         std::pmr::memory_resource        *pmr_rsrc;
 
         // @formatter:off
@@ -175,9 +274,9 @@ namespace melon::nbt
             using std::optional<Ref<Cont>>::optional;
 
             public:
-            template<tag_type_enum tag_type>
+            template<tag_type_enum tag_type, is_tag_lookup K>
             requires std::is_same_v<Cont, compound>
-            chained_optional_refwrap<Ref, tag_cont_t<tag_type>> find(const std::string_view &tag_name)
+            chained_optional_refwrap<Ref, tag_cont_t<tag_type>> find(const K &tag_name)
             {
                 if (this->has_value())
                     return this->value().get().template find<tag_type>(tag_name);
@@ -188,7 +287,7 @@ namespace melon::nbt
         // @formatter:on
 
     public:
-        mem::pmr::unique_ptr<std::pmr::string> name;
+        tag_name name;
 
         compound() = delete;
 
@@ -210,24 +309,67 @@ namespace melon::nbt
         // For parsing a binary NBT buffer
         // This function expects the raw buffer provided to it to be at least 8 bytes larger than the NBT data. The deflate methods in melon::util
         // will take care of this automatically.
-        explicit compound(std::unique_ptr<char[]> raw, size_t raw_size, const allocator_type &alloc = { });
+        explicit compound(std::unique_ptr<char[]> raw_in, size_t raw_size, const allocator_type &alloc = { })
+            : compound(std::move(raw_in), raw_size, { .borrow_buffer = false }, alloc)
+        { }
+
+        explicit compound(std::unique_ptr<char[]> raw_in, size_t raw_size, parse_args args, const allocator_type &alloc = { })
+            : compound(std::move(raw_in), raw_size, args, nullptr, nullptr, alloc)
+        { }
+
+        // Same as above, but the buffer is scanned first with heap_bytes() and the tree is parsed into a single arena of exactly that size,
+        // taken from alloc in one allocation. Anything added to the tree later that doesn't fit goes to alloc as usual.
+        //
+        // The arena belongs to the tree and goes when the root does. A node extracted from the tree is still in it, so it can only be inserted
+        // back into this tree (anywhere else throws), and mustn't be kept past the root.
+        explicit compound(std::unique_ptr<char[]> raw_in, size_t raw_size, exact_arena_t, parse_args args = { .borrow_buffer = false, .lazy = false, .intern_names = false, .names = nullptr, .threads = 1 }, const allocator_type &alloc = { })
+            : compound(std::move(raw_in), raw_size, args, make_arena(heap_bytes(raw_in.get(), raw_size, args), alloc.resource()), nullptr, alloc)
+        { }
+
+        // Same as above, but only the tags named by keep are built, along with the compounds leading to them. Everything else is skipped over
+        // without being allocated for, and is left out of bytes(), to_binary(), and the rest.
+        explicit compound(std::unique_ptr<char[]> raw_in, size_t raw_size, const projection &keep, parse_args args = { .borrow_buffer = false, .lazy = false, .intern_names = false, .names = nullptr, .threads = 1 }, const allocator_type &alloc = { })
+            : compound(std::move(raw_in), raw_size, args, nullptr, &keep.root(), alloc)
+        { }
 
+        // Validates a binary NBT buffer and returns how many bytes parsing it with the same arguments will allocate, without building
+        // anything. Like the parsing constructors, it expects the buffer to be padded.
+        static size_t heap_bytes(const char *raw, size_t raw_size, parse_args args = { .borrow_buffer = false, .lazy = false, .intern_names = false, .names = nullptr, .threads = 1 });
+
+        // Iterators hand out references to primitive values, so the compound is counted as changed from here on.
         iterator begin()
-        { return iterator(tags.begin()); }
+        {
+            materialize();
+            mark_dirty();
+            return iterator(tags.begin());
+        }
 
         iterator end()
-        { return iterator(tags.end()); }
+        {
+            materialize();
+            mark_dirty();
+            return iterator(tags.end());
+        }
 
         const_iterator cbegin()
-        { return const_iterator(tags.cbegin()); }
+        {
+            materialize();
+            mark_dirty();
+            return const_iterator(tags.cbegin());
+        }
 
         const_iterator cend()
-        { return const_iterator(tags.cend()); }
+        {
+            materialize();
+            mark_dirty();
+            return const_iterator(tags.cend());
+        }
 
-        template<tag_type_enum tag_type>
+        template<tag_type_enum tag_type, is_tag_lookup K>
         requires is_nbt_container<tag_type>
-        [[nodiscard]] chained_optional_refwrap<std::reference_wrapper, tag_cont_t<tag_type>> find(const std::string_view &tag_name) noexcept
+        [[nodiscard]] chained_optional_refwrap<std::reference_wrapper, tag_cont_t<tag_type>> find(const K &tag_name) noexcept
         {
+            materialize();
             auto itr = tags.find(tag_name);
 
             if (itr == tags.end() || !std::holds_alternative<tag_cont_t<tag_type> *>(itr->second))
@@ -236,44 +378,50 @@ namespace melon::nbt
                 return *std::get<tag_cont_t<tag_type> *>(itr->second);
         }
 
-        template<tag_type_enum tag_type>
+        template<tag_type_enum tag_type, is_tag_lookup K>
         requires is_nbt_primitive<tag_type>
-        [[nodiscard]] std::optional<std::reference_wrapper<tag_prim_t<tag_type>>> find(const std::string_view &tag_name) noexcept
+        [[nodiscard]] std::optional<std::reference_wrapper<tag_prim_t<tag_type>>> find(const K &tag_name) noexcept
         {
+            materialize();
             auto itr = tags.find(tag_name);
 
             if (itr == tags.end() || !std::holds_alternative<tag_cont_t<tag_type> *>(itr->second))
                 return std::nullopt;
-            else
-                return std::get<tag_cont_t<tag_type> *>(itr->second)->template get<tag_type>();
+
+            mark_dirty();
+            return std::get<tag_cont_t<tag_type> *>(itr->second)->template get<tag_type>();
         }
 
-        template<tag_type_enum tag_type>
+        template<tag_type_enum tag_type, is_tag_lookup K>
         requires is_nbt_array<tag_type>
         [[nodiscard]] std::optional<typename std::invoke_result<decltype(&primitive::template get<tag_type>), primitive *>::type>
-        find(const std::string_view &tag_name) noexcept
+        find(const K &tag_name) noexcept
         {
+            materialize();
             auto itr = tags.find(tag_name);
 
             if (itr == tags.end() || !std::holds_alternative<tag_cont_t<tag_type> *>(itr->second))
                 return std::nullopt;
-            else
-                return std::get<tag_cont_t<tag_type> *>(itr->second)->template get<tag_type>();
+
+            mark_dirty();
+            return std::get<tag_cont_t<tag_type> *>(itr->second)->template get<tag_type>();
         }
 
         std::optional<std::tuple<std::string_view, tag_type_enum, tag_variant_t>> find(const std::string_view &key, tag_type_enum type_requested = tag_end) noexcept;
+        std::optional<std::tuple<std::string_view, tag_type_enum, tag_variant_t>> find(const hashed_key &key, tag_type_enum type_requested = tag_end) noexcept;
 
         template<tag_type_enum tag_type>
         requires (tag_type == tag_compound)
         std::optional<std::reference_wrapper<compound>> create(std::string_view tag_name, const std::function<void(compound &)> &builder = nullptr)
         {
+            materialize();
             if (tags.contains(tag_name)) return std::nullopt;
             auto container = mem::pmr::make_unique<compound>(pmr_rsrc, this, tag_name);
 
             try
             {
                 if (builder) builder(*container);
-                const auto &[_, success] = tags.insert(std::pair{ std::string_view(*(container->name)), container.get() });
+                const auto &[_, success] = tags.insert(std::pair{ container->name.view(), container.get() });
                 if (!success) throw std::runtime_error("Failed to insert NBT compound.");
             }
             catch (...)
@@ -294,7 +442,8 @@ namespace melon::nbt
         requires is_nbt_container<tag_type>
         std::pair<iterator, bool> insert(tag_cont_t<tag_type> *container, insert_args args = { .overwrite = false })
         {
-            auto found = tags.find(std::string_view(*container->name));
+            materialize();
+            auto found = tags.find(container->name.view());
 
             if (found == tags.end() || args.overwrite)
             {
@@ -306,9 +455,16 @@ namespace melon::nbt
                     adjust_byte_count(container->bytes());
                     if ((depth + container->get_tree_depth()) > 512) throw std::runtime_error("Inserting NBT container would exceed maximum depth (>512).");
 
-                    auto &&[itr, success] = tags.insert(std::pair{ std::string_view(*container->name), container });
+                    auto &&[itr, success] = tags.insert(std::pair{ container->name.view(), container });
                     container->change_properties({ .new_depth = depth + 1, .new_max_bytes = max_bytes, .new_parent = this, .new_top = top });
 
+                    // A compound parsed in borrowing mode keeps its raw buffer, so its new tree now borrows as well. Likewise for its name pool.
+                    if constexpr (tag_type == tag_compound)
+                    {
+                        if (container->borrows) top->borrows = true;
+                        if (container->interns) top->interns = true;
+                    }
+
                     return { iterator(std::move(itr)), success };
                 }
                 catch (...)
@@ -329,7 +485,7 @@ namespace melon::nbt
             if (tag_name.size() >= std::numeric_limits<uint16_t>::max())
                 [[unlikely]] throw std::runtime_error("Attempted to add nbt primitive tag with too large name to NBT compound.");
 
-            auto [name_ptr, tag_ptr] = new_primitive(tag_name, tag_type, args.overwrite);
+            auto tag_ptr = new_primitive(tag_name, tag_type, args.overwrite);
 
             if constexpr (tag_type == tag_byte)
                 tag_ptr->value.tag_byte = value;
@@ -346,9 +502,7 @@ namespace melon::nbt
 
             this->adjust_byte_count(tag_ptr->bytes());
 
-            auto &&[itr, success] = tags.insert(std::pair{ std::string_view(*name_ptr), tag_ptr.get() });
-
-            static_cast<void>(name_ptr.release());
+            auto &&[itr, success] = tags.insert(std::pair{ tag_ptr->name.view(), tag_ptr.get() });
             static_cast<void>(tag_ptr.release());
 
             return { iterator(itr), success };
@@ -373,9 +527,19 @@ namespace melon::nbt
 
         node_type extract(const const_iterator &pos);
         node_type extract(const std::string_view &key, tag_type_enum type_requested = tag_end);
+        node_type extract(const hashed_key &key, tag_type_enum type_requested = tag_end);
 
         bool contains(const std::string_view key)
-        { return tags.contains(key); }
+        {
+            materialize();
+            return tags.contains(key);
+        }
+
+        bool contains(const hashed_key &key)
+        {
+            materialize();
+            return tags.contains(key);
+        }
 
         void merge(compound &src);
 
@@ -383,17 +547,51 @@ namespace melon::nbt
         { return iterator(destroy_tag(pos.itr)); }
 
         size_t erase(std::string_view &&key);
+        size_t erase(const hashed_key &key);
 
         void to_snbt(std::string &out);
         std::unique_ptr<std::string> to_snbt();
 
+        // Compounds and lists of a tree parsed with borrow_buffer or lazy that haven't changed since are copied out of the raw buffer as they
+        // are. Anything that hands out a reference to a primitive value counts as a change to the container holding it, whether or not it's
+        // written through, as does adding, removing or resizing a tag below it.
         std::pair<std::unique_ptr<char[]>, size_t> to_binary();
 
+        // Writes the whole tag into out, which needs room for bytes() of it, and returns how much was written. Nothing past that is touched.
+        size_t to_binary(std::span<char> out);
+
+        // Same as to_binary(), but the buffer comes from alloc. It's padded the same way, so it can be parsed straight back.
+        std::pair<std::unique_ptr<char[], mem::pmr::array_deleter<char[]>>, size_t> to_binary(const allocator_type &alloc);
+
+        // Writes the whole tag through scratch, handing sink each stretch of output as scratch fills up, so it's never all in memory at once.
+        // No stretch is longer than scratch, which has to be at least binary_scratch_min bytes. Subtrees that fit in what's left of scratch are
+        // written in one go, and bigger ones a tag at a time, down to arrays, strings and unparsed or unchanged subtrees, which are copied in
+        // pieces.
+        void to_binary(std::span<char> scratch, const std::function<void(std::span<const char>)> &sink);
+
+        static constexpr size_t binary_scratch_min = 16;
+
+        // Same as above, but written by up to threads threads, one per core by default. Every tag already knows its size in bytes, so where each
+        // one lands in the output is known before any of it is written. The framing of large compounds and lists is written up front, and the
+        // tags inside them are cut into runs of about binary_run_bytes that the threads write straight into place. Unparsed or unchanged
+        // subtrees and packed lists are never cut, and a tree smaller than a single run is written on the calling thread.
+        //
+        // Nothing in the tree may change while it's being written.
+        std::pair<std::unique_ptr<char[]>, size_t> to_binary_parallel(unsigned threads = 0);
+
         [[nodiscard]] size_t bytes() const
         { return byte_count_v; }
 
+        // Reading a lazily parsed compound counts as reading it, not changing it.
         [[nodiscard]] size_t size() const
-        { return tags.size(); }
+        {
+            const_cast<compound *>(this)->materialize();
+            return tags.size();
+        }
+
+        // Whether the tree was parsed in lazy mode, so that reading it may still allocate from its memory resource.
+        [[nodiscard]] bool is_lazy() const noexcept
+        { return top->state != nullptr && top->state->lazy; }
 
         uint16_t get_tree_depth();
         void clear();
@@ -408,22 +606,95 @@ namespace melon::nbt
     private:
         friend class list;
 
+        friend class parser;
+
+        friend class stream_parser;
+
+        friend class snbt_parser;
+
+        friend class tree_builder;
+
+        friend class tag_path;
+
         template<class T, class... Args>
         friend auto mem::pmr::make_obj_using_pmr(std::pmr::memory_resource *pmr_rsrc, Args &&... args)
         requires (!std::is_array_v<T>);
 
         explicit compound(std::variant<compound *, list *> parent_in, std::string_view name_in);
-        explicit compound(char **itr_in, const char *itr_end, std::variant<compound *, list *> parent_in, mem::pmr::unique_ptr<std::pmr::string> name_in);
+        explicit compound(const impl::parse_node_args &args);
+        explicit compound(std::unique_ptr<char[]> &&raw_in, size_t raw_size, parse_args args, arena_ptr arena_in, const projection::node *keep, const allocator_type &alloc);
 
-        std::pair<mem::pmr::unique_ptr<std::pmr::string>, mem::pmr::unique_ptr<primitive>> new_primitive(std::string_view, tag_type_enum, bool overwrite = false);
-        char *read(char *itr, const char *itr_end);
+        static arena_ptr make_arena(size_t bytes, std::pmr::memory_resource *upstream);
+
+        std::unique_ptr<primitive, primitive_deleter> new_primitive(std::string_view, tag_type_enum, bool overwrite = false, int32_t embed_len = -1);
         void adjust_byte_count(int64_t by);
         tag_list_t::iterator destroy_tag(const tag_list_t::iterator &itr);
+        std::optional<std::tuple<std::string_view, tag_type_enum, tag_variant_t>> describe_tag(tag_list_t::iterator itr, tag_type_enum type_requested);
+        node_type extract_tag(tag_list_t::iterator itr, tag_type_enum type_requested);
         void destroy_tag(std::variant<compound *, list *, primitive *> &tag_variant);
         void change_properties(impl::container_property_args props);
+        void copy_borrowed();
+
+        void materialize()
+        { if (lazy_begin != nullptr) [[unlikely]] read_lazy(); }
+
+        void read_lazy();
+
+        // Forgets the clean range of this compound and of every container above it.
+        void mark_dirty() noexcept
+        { if (clean_begin != nullptr) [[unlikely]] forget_clean(); }
+
+        void forget_clean() noexcept;
+
+        // The payload as it is in the raw buffer, while it's still exactly that: unparsed, or unchanged since it was parsed. Empty otherwise.
+        [[nodiscard]] std::span<const char> original() const noexcept
+        {
+            if (lazy_begin != nullptr) return { lazy_begin, lazy_end };
+            if (clean_begin != nullptr) return { clean_begin, clean_end };
+            return { };
+        }
 
         char *to_binary(char *itr);
 
+        // A run of tags for to_binary_parallel() to write at dst: entries of a compound with their headers, or elements of a list of compounds
+        // or lists without.
+        struct binary_run
+        {
+            char   *dst;
+            size_t bytes;
+            std::variant<std::span<tag_list_t::value_type>, std::pair<tag_type_enum, std::span<void *>>> tags;
+        };
+
+        static constexpr size_t binary_run_bytes = 64 * 1024;
+
+        // Buffers output for the sink overload of to_binary().
+        class binary_sink
+        {
+        public:
+            binary_sink(std::span<char> scratch_in, const std::function<void(std::span<const char>)> &sink_in)
+                    : scratch(scratch_in), sink(sink_in)
+            { }
+
+            // Room for bytes in one piece, handing on what's buffered first if need be. Null if they wouldn't fit in scratch at all.
+            char *reserve(size_t bytes);
+
+            void write(const void *src, size_t bytes);
+            void write_big_endian(const void *src, size_t count, size_t elem_size);
+            void write_header(tag_type_enum tag_type, std::string_view tag_name);
+            void flush();
+
+        private:
+            std::span<char>                                      scratch;
+            size_t                                               used = 0;
+            const std::function<void(std::span<const char>)> &sink;
+        };
+
+        static bool binary_splits(const std::variant<compound *, list *, primitive *> &tag);
+        static char *write_entries(char *itr, std::span<tag_list_t::value_type> entries);
+        static void write_binary(binary_sink &out, const std::variant<compound *, list *, primitive *> &tag, size_t bytes);
+        static char *plan_binary(list &target, char *itr, std::vector<binary_run> &runs);
+        char *plan_binary(char *itr, std::vector<binary_run> &runs);
+
         template<tag_type_enum tag_type, class V = std::remove_pointer_t<tag_prim_t<tag_type>>>
         requires is_nbt_type_match<V *, tag_type> && is_nbt_array<tag_type>
         std::pair<iterator, bool> insert_array_general(const std::string_view tag_name, const auto &values, bool overwrite = false)
@@ -434,31 +705,35 @@ namespace melon::nbt
             if ((tag_type == tag_string && values.size() >= std::numeric_limits<uint16_t>::max()) || (values.size() >= std::numeric_limits<int32_t>::max()))
                 [[unlikely]] throw std::runtime_error("Attempted to add too large array tag to NBT compound.");
 
-            auto [name_ptr, tag_ptr] = new_primitive(tag_name, tag_type, overwrite);
-            auto array_ptr           = mem::pmr::make_unique<V[]>(pmr_rsrc, values.size() + (padding_size / sizeof(V)));
+            auto embed_len = primitive::embeds(tag_type, static_cast<int32_t>(values.size())) ? static_cast<int32_t>(values.size()) : -1;
+            auto tag_ptr   = new_primitive(tag_name, tag_type, overwrite, embed_len);
 
-            tag_ptr->set_size(values.size());
-            this->adjust_byte_count(tag_ptr->bytes());
+            auto fill = [&values](V *dst) {
+                if constexpr (requires(decltype(values) v) { v.data(); v.size(); })
+                {
+                    if (values.size() > 0)
+                        std::memcpy(static_cast<void *>(dst), static_cast<const void *>(values.data()), values.size() * sizeof(V));
+                }
+                else
+                    for (uint32_t idx = 0; auto &&value: values)
+                        dst[idx++] = value;
+            };
 
-            if constexpr (tag_type == tag_string)
-                tag_ptr->value.tag_string     = array_ptr.get();
-            if constexpr (tag_type == tag_byte_array)
-                tag_ptr->value.tag_byte_array = array_ptr.get();
-            if constexpr (tag_type == tag_int_array)
-                tag_ptr->value.tag_int_array  = array_ptr.get();
-            if constexpr (tag_type == tag_long_array)
-                tag_ptr->value.tag_long_array = array_ptr.get();
-
-            if constexpr (requires(decltype(values) v) { v.data(); v.size(); })
-                std::memcpy(static_cast<void *>(array_ptr.get()), static_cast<const void *>(values.data()), values.size() * sizeof(V));
+            if (tag_ptr->value_embedded)
+                fill(static_cast<V *>(tag_ptr->value.generic_ptr));
             else
-                for (uint32_t idx = 0; auto &&value: values)
-                    array_ptr[idx++] = value;
+            {
+                auto array_ptr = mem::pmr::make_unique<V[]>(pmr_rsrc, values.size() + (padding_size / sizeof(V)));
+                fill(array_ptr.get());
+
+                // The primitive owns the array from here on, so its deleter will clean up if anything below throws.
+                tag_ptr->value.generic_ptr = static_cast<void *>(array_ptr.release());
+                tag_ptr->set_size(values.size());
+            }
 
-            auto &&[itr, success] = tags.insert(std::pair{ std::string_view(*name_ptr), tag_ptr.get() });
+            this->adjust_byte_count(tag_ptr->bytes());
 
-            static_cast<void>(name_ptr.release());
-            static_cast<void>(array_ptr.release());
+            auto &&[itr, success] = tags.insert(std::pair{ tag_ptr->name.view(), tag_ptr.get() });
             static_cast<void>(tag_ptr.release());
 
             return { iterator(itr), success };
@@ -466,9 +741,24 @@ namespace melon::nbt
 
         tag_list_t tags;
 
-        uint16_t depth        = 0;
-        size_t   byte_count_v = 0;
-        int64_t  max_bytes    = -1;
+        uint16_t depth = 0;
+
+        // Set on the top compound when anything in the tree may borrow from a raw buffer or a pool in own_names. Unlike the rest of the tree's
+        // state, these are set on whichever compound a borrowing subtree is inserted under, so every compound has room for them.
+        bool borrows = false;
+        bool interns = false;
+
+        size_t  byte_count_v = 0;
+        int64_t max_bytes    = -1;
+
+        // The unparsed payload of a lazily parsed compound, up to and including its END tag. Cleared once it has been read.
+        char *lazy_begin = nullptr;
+        char *lazy_end   = nullptr;
+
+        // The same range for a compound read from a buffer the tree keeps, once it has been parsed. Cleared as soon as anything below it may
+        // have changed.
+        char *clean_begin = nullptr;
+        char *clean_end   = nullptr;
     };
 
     static_assert(std::forward_iterator<compound::iterator>);
@@ -0,0 +1,177 @@
+#ifndef MELON_NBT_HASHED_KEY_H
+#define MELON_NBT_HASHED_KEY_H
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+#include <type_traits>
+
+namespace melon::nbt
+{
+    // The wyhash that ankerl::unordered_dense uses for strings, rewritten so it can run at compile time. Bytes are put together with shifts
+    // rather than memcpy, which compilers turn back into plain loads, and which gives the same hash on every platform.
+    namespace detail::wyhash
+    {
+        constexpr uint64_t mix(uint64_t a, uint64_t b) noexcept
+        {
+#if defined(__SIZEOF_INT128__)
+            __uint128_t r = a;
+            r *= b;
+            return static_cast<uint64_t>(r) ^ static_cast<uint64_t>(r >> 64U);
+#else
+            uint64_t ha = a >> 32U;
+            uint64_t hb = b >> 32U;
+            uint64_t la = static_cast<uint32_t>(a);
+            uint64_t lb = static_cast<uint32_t>(b);
+            uint64_t rh = ha * hb;
+            uint64_t rm0 = ha * lb;
+            uint64_t rm1 = hb * la;
+            uint64_t rl = la * lb;
+            uint64_t t = rl + (rm0 << 32U);
+            auto c = static_cast<uint64_t>(t < rl);
+            uint64_t lo = t + (rm1 << 32U);
+            c += static_cast<uint64_t>(lo < t);
+            uint64_t hi = rh + (rm0 >> 32U) + (rm1 >> 32U) + c;
+            return lo ^ hi;
+#endif
+        }
+
+        constexpr uint64_t r8(const char *p) noexcept
+        {
+            uint64_t v = 0;
+            for (int i = 7; i >= 0; i--) v = (v << 8U) | static_cast<uint8_t>(p[i]);
+            return v;
+        }
+
+        constexpr uint64_t r4(const char *p) noexcept
+        {
+            uint64_t v = 0;
+            for (int i = 3; i >= 0; i--) v = (v << 8U) | static_cast<uint8_t>(p[i]);
+            return v;
+        }
+
+        constexpr uint64_t r3(const char *p, size_t k) noexcept
+        {
+            return (static_cast<uint64_t>(static_cast<uint8_t>(p[0])) << 16U) | (static_cast<uint64_t>(static_cast<uint8_t>(p[k >> 1U])) << 8U) |
+                   static_cast<uint8_t>(p[k - 1]);
+        }
+    }
+
+    constexpr uint64_t hash_name(std::string_view name) noexcept
+    {
+        using namespace detail::wyhash;
+
+        constexpr std::array<uint64_t, 4> secret = { 0xa0761d6478bd642fULL, 0xe7037ed1a0b428dbULL, 0x8ebc6af09c88c6e3ULL, 0x589965cc75374cc3ULL };
+
+        const char *p = name.data();
+        size_t len = name.size();
+        uint64_t seed = secret[0];
+        uint64_t a = 0;
+        uint64_t b = 0;
+
+        if (len <= 16)
+        {
+            if (len >= 4)
+            {
+                a = (r4(p) << 32U) | r4(p + ((len >> 3U) << 2U));
+                b = (r4(p + len - 4) << 32U) | r4(p + len - 4 - ((len >> 3U) << 2U));
+            }
+            else if (len > 0)
+                a = r3(p, len);
+        }
+        else
+        {
+            size_t i = len;
+
+            if (i > 48)
+            {
+                uint64_t see1 = seed;
+                uint64_t see2 = seed;
+
+                do
+                {
+                    seed = mix(r8(p) ^ secret[1], r8(p + 8) ^ seed);
+                    see1 = mix(r8(p + 16) ^ secret[2], r8(p + 24) ^ see1);
+                    see2 = mix(r8(p + 32) ^ secret[3], r8(p + 40) ^ see2);
+                    p += 48;
+                    i -= 48;
+                } while (i > 48);
+
+                seed ^= see1 ^ see2;
+            }
+
+            while (i > 16)
+            {
+                seed = mix(r8(p) ^ secret[1], r8(p + 8) ^ seed);
+                i -= 16;
+                p += 16;
+            }
+
+            a = r8(p + i - 16);
+            b = r8(p + i - 8);
+        }
+
+        return mix(secret[1] ^ len, mix(a ^ secret[1], b ^ seed));
+    }
+
+    // A tag name hashed ahead of time. Compounds that have grown past their inline tags keep them in a hash map, and looking one of those up
+    // by a hashed_key skips hashing the name again. Keys written as "Data"_key are hashed at compile time; one made at runtime from a name
+    // that's only known then can be kept and reused across every compound it's looked up in.
+    //
+    // A key only views its name, so the characters have to outlive it. Literals live forever.
+    class hashed_key
+    {
+    public:
+        constexpr explicit hashed_key(std::string_view name_in) noexcept
+                : name(name_in), hash_v(hash_name(name_in))
+        { }
+
+        [[nodiscard]] constexpr std::string_view view() const noexcept
+        { return name; }
+
+        [[nodiscard]] constexpr uint64_t hash() const noexcept
+        { return hash_v; }
+
+        // So a key can go anywhere a name can, like compound::insert.
+        constexpr operator std::string_view() const noexcept // NOLINT(google-explicit-constructor)
+        { return name; }
+
+    private:
+        std::string_view name;
+        uint64_t         hash_v;
+    };
+
+    // What a compound's tags can be looked up by. Anything that converts to a string_view is hashed on the spot (if it's hashed at all).
+    template<class K>
+    concept is_tag_lookup = std::is_same_v<K, hashed_key> || std::is_convertible_v<const K &, std::string_view>;
+
+    namespace literals
+    {
+        consteval hashed_key operator ""_key(const char *name, size_t len) noexcept
+        { return hashed_key(std::string_view(name, len)); }
+    }
+
+    // Hashes names and keys alike, so a tag map can be searched with either.
+    struct name_hash
+    {
+        using is_transparent = void;
+        using is_avalanching = void;
+
+        constexpr uint64_t operator()(std::string_view name) const noexcept
+        { return hash_name(name); }
+
+        constexpr uint64_t operator()(const hashed_key &key) const noexcept
+        { return key.hash(); }
+    };
+
+    struct name_equal
+    {
+        using is_transparent = void;
+
+        constexpr bool operator()(std::string_view lhs, std::string_view rhs) const noexcept
+        { return lhs == rhs; }
+    };
+}
+
+#endif //MELON_NBT_HASHED_KEY_H
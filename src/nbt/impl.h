@@ -7,6 +7,8 @@
 
 #include <optional>
 #include <cstring>
+#include "util/simd.h"
+#include "tag_name.h"
 
 namespace melon::nbt::impl
 {
@@ -18,6 +20,18 @@ namespace melon::nbt::impl
         std::optional<compound *> new_top = std::nullopt;
     };
 
+    // Everything a container needs from the tree it's being parsed into.
+    struct parse_node_args : util::forced_named_init<parse_node_args>
+    {
+        std::variant<compound *, list *> parent;
+        compound                         *top;
+        std::pmr::memory_resource        *pmr_rsrc;
+        tag_name                         name;
+        uint16_t                         depth;
+        int64_t                          max_bytes;
+        tag_type_enum                    list_type = tag_end;
+    };
+
     template<class T>
     T read_var(char *&itr)
     {
@@ -27,6 +41,39 @@ namespace melon::nbt::impl
         return util::cvt_endian(var);
     }
 
+    // Bounds checks for each step of reading a binary buffer. parser::run() and walk_container() both go through these, so every way of reading
+    // a buffer accepts and rejects the same ones. Each check leaves more than padding_size bytes past what it covers, which is what lets the
+    // type bytes, length prefixes, and fixed size values that follow be read without a check of their own.
+
+    // Before the type of a compound entry. There has to be room for a name length even if it turns out to be an END tag.
+    inline void check_entry_bounds(const char *itr, const char *const itr_end)
+    {
+        if ((itr_end - itr) < static_cast<std::ptrdiff_t>(sizeof(tag_type_enum) + sizeof(uint16_t)))
+            [[unlikely]] throw std::runtime_error("NBT compound parsing ended before reaching END tag.");
+    }
+
+    // itr is just past the length of a name.
+    inline void check_name_bounds(const char *itr, const char *const itr_end, uint16_t name_len)
+    {
+        if ((itr + name_len + padding_size) >= itr_end)
+            [[unlikely]] throw std::runtime_error("Attempt to read past buffer while parsing binary NBT data.");
+    }
+
+    // Before a list element. Only compounds and lists are checked here. Fixed size values are checked as one run when the list is opened, and
+    // strings and arrays once their length has been read.
+    inline void check_element_bounds(const char *itr, const char *const itr_end, tag_type_enum tag_type)
+    {
+        if ((tag_properties[tag_type].category & (cat_compound | cat_list)) && (itr + sizeof(tag_type_enum) + padding_size) >= itr_end)
+            [[unlikely]] throw std::runtime_error("Attempt to read past buffer while parsing binary NBT data.");
+    }
+
+    // itr is at a payload of payload_bytes, past any length prefix. Also used for the values of a list of fixed size values as a whole.
+    inline void check_payload_bounds(const char *itr, const char *const itr_end, size_t payload_bytes)
+    {
+        if (payload_bytes + padding_size >= static_cast<size_t>(itr_end - itr))
+            [[unlikely]] throw std::runtime_error("Attempt to read past buffer while parsing binary NBT data.");
+    }
+
     uint64_t inline
 #ifdef __GNUC__
     __attribute__((always_inline))
@@ -58,24 +105,20 @@ namespace melon::nbt::impl
 
         if (array_len < 0) [[unlikely]] throw std::runtime_error("Found array with negative length while parsing binary NBT data.");
 
-        if ((*itr + (array_len * tag_properties[tag_type].size) + padding_size) >= itr_end)
-            [[unlikely]] throw std::runtime_error("Attempt to read past buffer while parsing binary NBT data.");
+        auto array_bytes = static_cast<size_t>(array_len) * tag_properties[tag_type].size;
+        check_payload_bounds(*itr, itr_end, array_bytes);
 
-        auto array_size  = array_len * tag_properties[tag_type].size + padding_size;
+        auto array_size  = array_bytes + padding_size;
         auto array_align = tag_properties[tag_type].size;
         auto array_ptr   = static_cast<char *>(pmr_rsrc->allocate(array_size, array_align));
 
         auto array_uptr = std::unique_ptr<char[], mem::pmr::generic_deleter<char[]>>
         (array_ptr, mem::pmr::generic_deleter<char[]>(pmr_rsrc, array_size, array_align));
 
-        // My take on a branchless conversion of an unaligned big endian array of an arbitrarily sized data type to an aligned little endian array.
-        for (auto array_idx = 0; array_idx < array_len; array_idx++)
-        {
-            uint64_t prim_value = read_tag_primitive(itr, tag_type);
-            std::memcpy(static_cast<void *>(array_ptr), static_cast<const void *>(&prim_value), sizeof(prim_value));
-
-            array_ptr += tag_properties[tag_type].size;
-        }
+        // Converts the unaligned big endian array to an aligned native endian array in bulk. The SIMD kernel is picked at runtime, and it falls
+        // back to a scalar loop if nothing better is available.
+        util::cvt_endian_array(array_ptr, *itr, array_len, tag_properties[tag_type].size);
+        *itr += array_bytes;
 
         return std::make_tuple(std::move(array_uptr), array_len);
     }
@@ -90,9 +133,7 @@ namespace melon::nbt::impl
         // Reminder: NBT strings are "Modified UTF-8" and not null terminated.
         // https://en.wikipedia.org/wiki/UTF-8#Modified_UTF-8
         auto str_len = read_var<uint16_t>(*itr);
-
-        if ((*itr + str_len + padding_size) >= itr_end)
-            [[unlikely]] throw std::runtime_error("Attempt to read past buffer while parsing binary NBT data.");
+        check_payload_bounds(*itr, itr_end, str_len);
 
         auto str_ptr = mem::pmr::make_unique<char[]>(pmr_rsrc, str_len + padding_size);
         std::memcpy(str_ptr.get(), *itr, str_len);
@@ -100,6 +141,195 @@ namespace melon::nbt::impl
 
         return std::make_tuple(std::move(str_ptr), str_len);
     }
+
+    // Borrowing counterpart of read_tag_string and read_tag_array for payloads that need no conversion (strings and byte arrays). The returned
+    // pointer points into the raw buffer, which must outlive the tag.
+    std::tuple<char *, int32_t>
+    inline
+#ifdef __GNUC__
+    __attribute__((always_inline))
+#endif
+    borrow_tag_payload(char **itr, const char *const itr_end, tag_type_enum tag_type)
+    {
+        int32_t payload_len;
+
+        if (tag_type == tag_string)
+            payload_len = read_var<uint16_t>(*itr);
+        else
+            payload_len = read_var<int32_t>(*itr);
+
+        if (payload_len < 0) [[unlikely]] throw std::runtime_error("Found array with negative length while parsing binary NBT data.");
+        check_payload_bounds(*itr, itr_end, static_cast<size_t>(payload_len) * tag_properties[tag_type].size);
+
+        auto payload_ptr = *itr;
+        *itr += payload_len;
+
+        return std::make_tuple(payload_ptr, payload_len);
+    }
+
+    // Reads the length prefix of a string or array payload and checks the payload is inside the buffer. A fixed size value was already covered
+    // by the check of the name or list before it, so it's only sized. Returns the size of the payload in bytes, with itr left at its start.
+    inline size_t read_payload_extent(char *&itr, const char *const itr_end, tag_type_enum tag_type)
+    {
+        size_t payload_bytes;
+
+        // Length prefixes are checked on their own, since they may sit right up against the padding.
+        auto ensure_bytes = [&itr, itr_end](size_t bytes) {
+            if (static_cast<size_t>(itr_end - itr) < bytes) [[unlikely]] throw std::runtime_error("Attempt to read past buffer while parsing binary NBT data.");
+        };
+
+        if (tag_properties[tag_type].category == cat_primitive)
+            return tag_properties[tag_type].size;
+        else if (tag_type == tag_string)
+        {
+            ensure_bytes(sizeof(uint16_t));
+            payload_bytes = read_var<uint16_t>(itr);
+        }
+        else
+        {
+            ensure_bytes(sizeof(int32_t));
+            auto array_len = read_var<int32_t>(itr);
+            if (array_len < 0) [[unlikely]] throw std::runtime_error("Found array with negative length while parsing binary NBT data.");
+
+            payload_bytes = static_cast<size_t>(array_len) * tag_properties[tag_type].size;
+        }
+
+        check_payload_bounds(itr, itr_end, payload_bytes);
+        return payload_bytes;
+    }
+
+    // Walks over the payload of a compound or list without building anything, and returns a pointer just past it. The same bounds, type, and
+    // depth checks as a full parse are applied along the way. For lists itr must point at the element count, as the element type has already
+    // been read by the parent.
+    //
+    // The visitor is told about everything found on the way:
+    //   open(type, name, elem_type, count)      - a compound or list was entered, starting with the one being walked. elem_type and count are
+    //                                             tag_end and 0 for compounds.
+    //   close(type, entries)                    - a compound or list was left, after all of its tags or elements.
+    //   tag(type, name, payload, payload_len)   - a non-container tag. payload points at its big endian value, past any length prefix, and
+    //                                             payload_len is the length of a string or array, or 0 for anything else.
+    // Names point into the buffer. List elements have empty names, and the container being walked is reported with the name passed in.
+    template<class Visitor>
+    char *walk_container(char *itr, const char *const itr_end, tag_type_enum container_type, tag_type_enum list_type, uint16_t depth, Visitor &&visitor,
+                         std::string_view name = { })
+    {
+        struct frame
+        {
+            tag_type_enum type;
+            tag_type_enum list_type;
+            int32_t       remaining;
+            int32_t       entries;
+        };
+
+        frame  stack[513];
+        size_t stack_size = 0;
+
+        // Type bytes and length prefixes are checked on their own, since they may sit right up against the padding.
+        auto ensure_bytes = [&itr, itr_end](size_t bytes) {
+            if (static_cast<size_t>(itr_end - itr) < bytes) [[unlikely]] throw std::runtime_error("Attempt to read past buffer while parsing binary NBT data.");
+        };
+
+        auto push_frame = [&](tag_type_enum type, tag_type_enum elem_type, std::string_view tag_name) {
+            if (depth + stack_size > 512) [[unlikely]] throw std::runtime_error("NBT Depth exceeds 512.");
+
+            int32_t count = 0;
+
+            if (type == tag_list)
+            {
+                ensure_bytes(sizeof(int32_t));
+                count = read_var<int32_t>(itr);
+
+                if (count < 0) [[unlikely]] throw std::runtime_error("Found list with negative length while parsing binary NBT data.");
+                if (elem_type == tag_end && count > 0) [[unlikely]] throw std::runtime_error("Found populated list with no type.");
+
+                if (tag_properties[elem_type].category == cat_primitive) check_payload_bounds(itr, itr_end, static_cast<size_t>(count) * tag_properties[elem_type].size);
+            }
+
+            visitor.open(type, tag_name, elem_type, count);
+            stack[stack_size++] = { type, elem_type, count, count };
+        };
+
+        push_frame(container_type, list_type, name);
+
+        while (stack_size > 0)
+        {
+            auto          &current = stack[stack_size - 1];
+            tag_type_enum    tag_type;
+            std::string_view tag_name;
+
+            if (current.type == tag_compound)
+            {
+                check_entry_bounds(itr, itr_end);
+
+                tag_type = static_cast<tag_type_enum>(*itr++);
+                if (static_cast<uint8_t>(tag_type) >= tag_properties.size()) [[unlikely]] throw std::runtime_error("Invalid NBT Tag Type.");
+
+                if (tag_type == tag_end)
+                {
+                    visitor.close(tag_compound, current.entries);
+                    stack_size--;
+                    continue;
+                }
+
+                auto name_len = read_var<uint16_t>(itr);
+                check_name_bounds(itr, itr_end, name_len);
+
+                tag_name = { itr, name_len };
+                itr += name_len;
+                current.entries++;
+            }
+            else
+            {
+                if (current.remaining == 0)
+                {
+                    visitor.close(tag_list, current.entries);
+                    stack_size--;
+                    continue;
+                }
+
+                current.remaining--;
+                tag_type = current.list_type;
+
+                check_element_bounds(itr, itr_end, tag_type);
+            }
+
+            if (tag_type == tag_compound)
+                push_frame(tag_compound, tag_end, tag_name);
+            else if (tag_type == tag_list)
+            {
+                ensure_bytes(sizeof(tag_type_enum));
+
+                auto elem_type = static_cast<tag_type_enum>(*itr++);
+                if (static_cast<uint8_t>(elem_type) >= tag_properties.size()) [[unlikely]] throw std::runtime_error("Invalid NBT Tag Type.");
+
+                push_frame(tag_list, elem_type, tag_name);
+            }
+            else
+            {
+                auto payload_bytes = read_payload_extent(itr, itr_end, tag_type);
+                auto payload_len   = tag_properties[tag_type].category == cat_primitive ? 0 : payload_bytes / tag_properties[tag_type].size;
+
+                visitor.tag(tag_type, tag_name, static_cast<const char *>(itr), static_cast<int32_t>(payload_len));
+                itr += payload_bytes;
+            }
+        }
+
+        return itr;
+    }
+
+    inline char *skip_container(char *itr, const char *const itr_end, tag_type_enum container_type, tag_type_enum list_type, uint16_t depth)
+    {
+        // @formatter:off
+        struct
+        {
+            void open(tag_type_enum, std::string_view, tag_type_enum, int32_t) noexcept { }
+            void close(tag_type_enum, int32_t) noexcept { }
+            void tag(tag_type_enum, std::string_view, const char *, int32_t) noexcept { }
+        } ignore_all;
+        // @formatter:on
+
+        return walk_container(itr, itr_end, container_type, list_type, depth, ignore_all);
+    }
 }
 
 #endif //MELON_NBT_IMPL_H
@@ -4,75 +4,91 @@
 
 #include "compound.h"
 #include "list.h"
+#include "list_index.h"
 #include "snbt.h"
 
 namespace melon::nbt
 {
-    list::list(std::variant<compound *, list *> parent_in, std::string_view name_in, tag_type_enum tag_type_in)
-            : parent(parent_in),
-              top(std::visit([](auto &&tag) -> compound * { return tag->top; }, parent_in)),
-              pmr_rsrc(std::visit([](auto &&tag) -> std::pmr::memory_resource * { return tag->pmr_rsrc; }, parent_in)),
-              name(mem::pmr::make_unique<std::pmr::string>(pmr_rsrc, name_in)),
-              type_v(tag_type_in),
-              tags(tag_list_t(pmr_rsrc))
+    namespace
     {
-        std::visit([this](auto &&tag) {
-            depth     = tag->depth + 1;
-            max_bytes = tag->max_bytes;
-        }, parent_in);
+        // Layout of the compounds or lists kept in a list's slab.
+        constexpr size_t slab_elem_size(tag_type_enum tag_type)
+        { return tag_type == tag_compound ? sizeof(compound) : sizeof(list); }
 
-        if (std::holds_alternative<list *>(parent))
-            adjust_byte_count(sizeof(int8_t) + sizeof(int32_t));
-        else
-            adjust_byte_count(sizeof(int8_t) + sizeof(uint16_t) + name->size() + sizeof(int8_t) + sizeof(int32_t));
+        constexpr size_t slab_elem_align(tag_type_enum tag_type)
+        { return tag_type == tag_compound ? alignof(compound) : alignof(list); }
     }
 
-    list::list(char **itr_in, const char *itr_end, std::variant<compound *, list *> parent_in, mem::pmr::unique_ptr<std::pmr::string> name_in, tag_type_enum tag_type_in)
+    list::list(std::variant<compound *, list *> parent_in, std::string_view name_in, tag_type_enum tag_type_in)
             : parent(parent_in),
               top(std::visit([](auto &&tag) -> compound * { return tag->top; }, parent_in)),
               pmr_rsrc(std::visit([](auto &&tag) -> std::pmr::memory_resource * { return tag->pmr_rsrc; }, parent_in)),
-              name(std::move(name_in)),
+              name(nbt::tag_name::copy_of(name_in, pmr_rsrc)),
               type_v(tag_type_in),
               tags(tag_list_t(pmr_rsrc))
     {
-        if (depth > 512)
-            throw std::runtime_error("NBT Depth exceeds 512.");
-
         std::visit([this](auto &&tag) {
             depth     = tag->depth + 1;
             max_bytes = tag->max_bytes;
         }, parent_in);
 
-        if (std::holds_alternative<list *>(parent))
-            byte_count_v += sizeof(int8_t); // list::read parent reads the list data type byte
-        else
-            byte_count_v += sizeof(uint16_t) + name->size() + sizeof(int8_t) + sizeof(int8_t); // compound::read parent reads the list tag type and list data type byte
-
         try
         {
-            *itr_in = read(*itr_in, itr_end);
+            if (std::holds_alternative<list *>(parent))
+                adjust_byte_count(sizeof(int8_t) + sizeof(int32_t));
+            else
+                adjust_byte_count(sizeof(int8_t) + sizeof(uint16_t) + name.size() + sizeof(int8_t) + sizeof(int32_t));
         }
         catch (...)
         {
-            clear();
+            name.release(pmr_rsrc);
             throw;
         }
     }
 
+    list::list(const impl::parse_node_args &args)
+            : parent(args.parent),
+              top(args.top),
+              pmr_rsrc(args.pmr_rsrc),
+              name(args.name),
+              type_v(args.list_type),
+              tags(tag_list_t(pmr_rsrc)),
+              depth(args.depth),
+              max_bytes(args.max_bytes)
+    {
+        // Counted as empty until the parser closes it.
+        if (std::holds_alternative<list *>(parent))
+            byte_count_v = sizeof(int8_t) + sizeof(int32_t);
+        else
+            byte_count_v = sizeof(int8_t) + sizeof(uint16_t) + name.size() + sizeof(int8_t) + sizeof(int32_t);
+    }
+
     list::~list()
     {
         clear();
 
+        for (auto index = indexes; index != nullptr; index = index->next_index)
+            index->detach();
+
+        if (packed_v != nullptr)
+            pmr_rsrc->deallocate(packed_v, packed_capacity * tag_properties[type()].size, tag_properties[type()].size);
+
+        if (slab_v != nullptr)
+            pmr_rsrc->deallocate(slab_v, slab_count * slab_elem_size(type()), slab_elem_align(type()));
+
         if (std::holds_alternative<list *>(parent))
             adjust_byte_count((sizeof(int8_t) + sizeof(int32_t)) * -1);
         else
-            adjust_byte_count((sizeof(int8_t) + sizeof(uint16_t) + name->size() + sizeof(int8_t) + sizeof(int32_t)) * -1);
+            adjust_byte_count((sizeof(int8_t) + sizeof(uint16_t) + name.size() + sizeof(int8_t) + sizeof(int32_t)) * -1);
+
+        name.release(pmr_rsrc);
 
         assert(byte_count_v == 0);
     }
 
     uint16_t list::get_tree_depth()
     {
+        materialize();
         uint16_t ret = depth;
         uint16_t child_depth;
 
@@ -122,8 +138,66 @@ namespace melon::nbt
         }
     }
 
+    void list::copy_borrowed()
+    {
+        materialize();
+        name.make_owned(pmr_rsrc);
+
+        if (type() == tag_list)
+        {
+            for (const auto &itr: tags)
+                static_cast<list *>(itr)->copy_borrowed();
+        }
+        else if (type() == tag_compound)
+        {
+            for (const auto &itr: tags)
+                static_cast<compound *>(itr)->copy_borrowed();
+        }
+        else
+        {
+            for (const auto &itr: tags)
+                static_cast<primitive *>(itr)->copy_borrowed(pmr_rsrc);
+        }
+
+        clean_begin = nullptr;
+    }
+
+    void list::read_lazy()
+    {
+        auto range_begin      = std::exchange(lazy_begin, nullptr);
+        auto byte_count_saved = byte_count_v;
+
+        // The parser counts the range again as it goes.
+        byte_count_v -= lazy_end - range_begin;
+
+        try
+        {
+            // The range was checked when it was skipped over, and the buffer is padded past its end.
+            parser::read(*this, range_begin, lazy_end + padding_size + 1);
+        }
+        catch (...)
+        {
+            // Unwind without touching the byte counts of our parents, which never saw the partially read tags.
+            auto parent_saved = std::exchange(parent, static_cast<list *>(nullptr));
+            clear();
+            parent = parent_saved;
+
+            byte_count_v = byte_count_saved;
+            lazy_begin   = range_begin;
+            throw;
+        }
+    }
+
     void list::clear()
     {
+        if (lazy_begin != nullptr)
+        {
+            // Nothing was parsed, so there is nothing to free. Forget the range, leaving only the element count counted.
+            adjust_byte_count((lazy_end - lazy_begin - sizeof(int32_t)) * -1);
+            lazy_begin = nullptr;
+            return;
+        }
+
         erase(begin(), end());
     }
 
@@ -134,30 +208,44 @@ namespace melon::nbt
 
     list::generic_iterator list::erase(const generic_iterator& first, const generic_iterator& last)
     {
+        if (is_packed())
+        {
+            if (first.idx == last.idx) return first;
+
+            auto elem_size = tag_properties[type()].size;
+            auto data      = static_cast<char *>(packed_v);
+
+            adjust_byte_count(static_cast<int64_t>((last.idx - first.idx) * elem_size) * -1);
+
+            std::memmove(data + first.idx * elem_size, data + last.idx * elem_size, (packed_count - last.idx) * elem_size);
+            packed_count -= last.idx - first.idx;
+
+            return generic_iterator(first.idx, this);
+        }
+
         auto clear_loop = [this, first, last]<class T>() {
-            for (auto itr = first; itr != last; itr++)
+            for (auto itr = tags.begin() + first.idx; itr != tags.begin() + last.idx; itr++)
             {
-                auto tag_ptr = static_cast<T *>(itr.fetch_raw_ptr());
+                auto tag_ptr = static_cast<T *>(*itr);
 
                 if constexpr (std::is_same_v<T, primitive>)
                 {
                     adjust_byte_count(tag_ptr->bytes({ .full_tag = false }) * -1);
-
-                    if (tag_ptr->name != nullptr)
-                    {
-                        std::destroy_at(tag_ptr->name);
-                        pmr_rsrc->deallocate(tag_ptr->name, sizeof(std::remove_pointer_t<decltype(tag_ptr->name)>), alignof(std::remove_pointer_t<decltype(tag_ptr->name)>));
-                    }
-
-                    if (tag_properties[type()].category & (cat_array | cat_string) && tag_ptr->value.generic_ptr != nullptr)
-                        pmr_rsrc->deallocate(tag_ptr->value.generic_ptr, tag_ptr->size() * tag_properties[type()].size + padding_size, tag_properties[type()].size);
+                    primitive::destroy(tag_ptr, pmr_rsrc);
                 }
+                else
+                {
+                    if constexpr (std::is_same_v<T, compound>)
+                        if (indexes != nullptr) index_removed(*tag_ptr);
 
-                std::destroy_at(tag_ptr);
-                pmr_rsrc->deallocate(tag_ptr, sizeof(T), alignof(T));
+                    destroy_element(tag_ptr);
+                }
             }
 
-            return generic_iterator(tags.erase(first.itr, last.itr), this);
+            auto next = tags.erase(tags.begin() + first.idx, tags.begin() + last.idx);
+            if (tags.empty()) slab_used = 0;
+
+            return generic_iterator(static_cast<int>(next - tags.begin()), this);
         };
 
         if (type() == tag_list)
@@ -168,113 +256,131 @@ namespace melon::nbt
             return clear_loop.template operator()<primitive>();
     }
 
-    tag_variant_t list::at(int idx)
+    void list::reserve_slab(size_t count_in)
     {
-        if (type() == tag_compound)
-            return std::reference_wrapper<compound>(*static_cast<compound *>(tags.at(idx)));
-        else if (type() == tag_list)
-            return std::reference_wrapper<list>(*static_cast<list *>(tags.at(idx)));
-        else
-        {
-            auto prim_ptr = static_cast<primitive *>(tags.at(idx));
-            return prim_ptr->get_generic();
-        }
+        if (slab_used > 0 || count_in <= slab_count) return;
+
+        auto new_slab = pmr_rsrc->allocate(count_in * slab_elem_size(type()), slab_elem_align(type()));
+
+        if (slab_v != nullptr) pmr_rsrc->deallocate(slab_v, slab_count * slab_elem_size(type()), slab_elem_align(type()));
+
+        slab_v     = new_slab;
+        slab_count = count_in;
     }
 
-    char *list::read(char *itr, const char *const itr_end)
+    bool list::in_slab(const void *ptr) const noexcept
     {
-        static_assert(sizeof(tag_type_enum) == sizeof(char));
+        auto slab_ptr = static_cast<const char *>(slab_v);
+        return ptr >= slab_ptr && ptr < slab_ptr + slab_count * slab_elem_size(type());
+    }
 
-        auto itr_start = itr;
+    void *list::next_slab_slot() noexcept
+    {
+        if (slab_used == slab_count) return nullptr;
 
-        auto count = impl::read_var<int32_t>(itr);
+        return static_cast<char *>(slab_v) + (slab_used++) * slab_elem_size(type());
+    }
 
-        if (count < 0) [[unlikely]] throw std::runtime_error("Found list with negative length while parsing binary NBT data.");
-        if (type() == tag_end && count > 0) throw std::runtime_error("Found populated list with no type.");
+    void list::reserve_packed(size_t count_in)
+    {
+        if (count_in <= packed_capacity) return;
 
-        tags.reserve(count);
+        auto elem_size = tag_properties[type()].size;
+        auto new_data  = pmr_rsrc->allocate(count_in * elem_size, elem_size);
 
-        if (tag_properties[type()].category & (cat_compound | cat_list))
+        if (packed_v != nullptr)
         {
-            if (type() == tag_list)
-            {
-                for (int32_t index = 0; index < count; index++)
-                {
-                    if ((itr + sizeof(tag_type_enum) + padding_size) >= itr_end)
-                        [[unlikely]] throw std::runtime_error("Attempt to read past buffer while parsing binary NBT data.");
+            std::memcpy(new_data, packed_v, packed_count * elem_size);
+            pmr_rsrc->deallocate(packed_v, packed_capacity * elem_size, elem_size);
+        }
 
-                    auto list_type = static_cast<tag_type_enum>(*itr++);
-                    if (static_cast<uint8_t>(list_type) >= tag_properties.size()) [[unlikely]] throw std::runtime_error("Invalid NBT Tag Type.");
+        packed_v        = new_data;
+        packed_capacity = count_in;
+    }
 
-                    tags.push_back(mem::pmr::make_obj_using_pmr<list>(pmr_rsrc, &itr, itr_end, this, mem::pmr::make_empty_unique<std::pmr::string>(pmr_rsrc), list_type));
-                }
-            }
-            else if (type() == tag_compound)
-            {
-                for (int32_t index = 0; index < count; index++)
-                {
-                    if ((itr + sizeof(tag_type_enum) + padding_size) >= itr_end)
-                        [[unlikely]] throw std::runtime_error("Attempt to read past buffer while parsing binary NBT data.");
+    tag_variant_t list::at(int idx)
+    {
+        materialize();
 
-                    tags.push_back(mem::pmr::make_obj_using_pmr<compound>(pmr_rsrc, &itr, itr_end, this, mem::pmr::make_empty_unique<std::pmr::string>(pmr_rsrc)));
-                }
-            }
-        }
-        else if (tag_properties[type()].category == cat_primitive)
-        {
-            for (int32_t index = 0; index < count; index++)
-            {
-                if ((itr + tag_properties[type()].size + padding_size) >= itr_end)
-                    [[unlikely]] throw std::runtime_error("Attempt to read past buffer while parsing binary NBT data.");
+        if (idx < 0 || static_cast<size_t>(idx) >= size()) [[unlikely]] throw std::out_of_range("NBT list index out of range.");
 
-                tags.push_back(mem::pmr::make_obj_using_pmr<primitive>(pmr_rsrc, type(), impl::read_tag_primitive(&itr, type())));
-            }
-        }
-        else if (tag_properties[type()].category & (cat_array | cat_string))
+        if (!holds_containers()) mark_dirty();
+        return element(idx);
+    }
+
+    void list::index_added(compound &element)
+    {
+        for (auto index = indexes; index != nullptr; index = index->next_index)
         {
-            if (type() == tag_string)
+            try
             {
-                for (int32_t index = 0; index < count; index++)
-                {
-                    auto [str_ptr, str_len] = impl::read_tag_string(&itr, itr_end, pmr_rsrc);
-                    tags.push_back(mem::pmr::make_obj_using_pmr<primitive>(pmr_rsrc, type(), std::bit_cast<uint64_t>(str_ptr.get()), nullptr, static_cast<size_t>(str_len)));
-                    static_cast<void>(str_ptr.release());
-                }
+                index->added(element);
             }
-            else
+            catch (...)
             {
-                for (int32_t index = 0; index < count; index++)
-                {
-                    auto [array_ptr, array_len] = impl::read_tag_array(&itr, itr_end, type(), pmr_rsrc);
-                    if (array_len < 0) [[unlikely]] throw std::runtime_error("Found array with negative length while parsing binary NBT data.");
+                for (auto added_to = indexes; added_to != index; added_to = added_to->next_index)
+                    added_to->removed(element);
 
-                    tags.push_back(mem::pmr::make_obj_using_pmr<primitive>(pmr_rsrc, type(), std::bit_cast<uint64_t>(array_ptr.get()), nullptr, static_cast<size_t>(array_len)));
-                    static_cast<void>(array_ptr.release());
-                }
+                throw;
             }
         }
+    }
 
-        byte_count_v += itr - itr_start;
-        return itr;
+    void list::index_removed(compound &element) noexcept
+    {
+        for (auto index = indexes; index != nullptr; index = index->next_index)
+            index->removed(element);
+    }
+
+    tag_variant_t list::element(int idx)
+    {
+        // @formatter:off
+        switch (type())
+        {
+            case tag_compound: return std::reference_wrapper<compound>(*static_cast<compound *>(tags[idx]));
+            case tag_list:     return std::reference_wrapper<list>(*static_cast<list *>(tags[idx]));
+            case tag_byte:     return std::reference_wrapper<tag_access_t<tag_byte>>(static_cast<tag_prim_t<tag_byte> *>(packed_v)[idx]);
+            case tag_short:    return std::reference_wrapper<tag_access_t<tag_short>>(static_cast<tag_prim_t<tag_short> *>(packed_v)[idx]);
+            case tag_int:      return std::reference_wrapper<tag_access_t<tag_int>>(static_cast<tag_prim_t<tag_int> *>(packed_v)[idx]);
+            case tag_long:     return std::reference_wrapper<tag_access_t<tag_long>>(static_cast<tag_prim_t<tag_long> *>(packed_v)[idx]);
+            case tag_float:    return std::reference_wrapper<tag_access_t<tag_float>>(static_cast<tag_prim_t<tag_float> *>(packed_v)[idx]);
+            case tag_double:   return std::reference_wrapper<tag_access_t<tag_double>>(static_cast<tag_prim_t<tag_double> *>(packed_v)[idx]);
+            default:           return static_cast<primitive *>(tags[idx])->get_generic();
+        }
+        // @formatter:on
     }
 
     void list::to_snbt(std::string &out) const
     {
-        if (name != nullptr && !name->empty())
+        const_cast<list *>(this)->materialize();
+
+        if (!name.empty())
         {
-            snbt::escape_string(*name, out, false);
+            snbt::escape_string(name, out, false);
             out.push_back(':');
         }
 
         out.push_back('[');
 
-        if (!tags.empty() && type() != tag_end)
+        if (is_packed() && packed_count > 0)
+        {
+            auto elem_size = tag_properties[type()].size;
+
+            for (size_t idx = 0; idx < packed_count; idx++)
+            {
+                primitive::value_to_snbt(type(), static_cast<const char *>(packed_v) + idx * elem_size, out);
+                out.push_back(',');
+            }
+
+            out.back() = ']';
+        }
+        else if (!tags.empty() && type() != tag_end)
         {
             auto process_entries = [&out]<typename T>(const tag_list_t &vec) {
                 for (auto &tag: vec)
                 {
                     auto entry = static_cast<T *>(tag);
-                    if (entry->name != nullptr && !entry->name->empty()) [[unlikely]] throw std::runtime_error("Unexpected named tag in NBT list.");
+                    if (!entry->name.empty()) [[unlikely]] throw std::runtime_error("Unexpected named tag in NBT list.");
 
                     entry->to_snbt(out);
                     out.push_back(',');
@@ -296,14 +402,24 @@ namespace melon::nbt
 
     char *list::to_binary(char *itr) const
     {
-        if (!tags.empty() && type() != tag_end)
+        // An unparsed or unchanged list is still exactly what it was in the raw buffer. Empty ones are left to the normal path to be written as
+        // TAG_End lists.
+        if (auto range = original(); !range.empty() && size() > 0)
+        {
+            *itr++ = static_cast<int8_t>(type());
+
+            std::memcpy(itr, range.data(), range.size());
+            return itr + range.size();
+        }
+
+        if (size() > 0 && type() != tag_end)
         {
             auto tag_type = type();
 
             *itr = static_cast<int8_t>(tag_type);
             itr++;
 
-            auto count = util::cvt_endian<std::endian::little, std::endian::big>(static_cast<int32_t>(tags.size()));
+            auto count = util::cvt_endian<std::endian::little, std::endian::big>(static_cast<int32_t>(size()));
             std::memcpy(itr, &count, sizeof(decltype(count)));
             itr += sizeof(decltype(count));
 
@@ -315,7 +431,12 @@ namespace melon::nbt
                 }
             };
 
-            if (tag_type == tag_list)
+            if (is_packed())
+            {
+                util::cvt_endian_array<std::endian::native, std::endian::big>(itr, packed_v, packed_count, tag_properties[tag_type].size);
+                itr += packed_count * tag_properties[tag_type].size;
+            }
+            else if (tag_type == tag_list)
                 process_entries.template operator()<list>(tags);
             else if (tag_type == tag_compound)
                 process_entries.template operator()<compound>(tags);
@@ -336,6 +457,7 @@ namespace melon::nbt
     template<>
     std::optional<std::reference_wrapper<list>> compound::create<tag_list>(std::string_view tag_name, tag_type_enum tag_type_in, const std::function<void(list &)> &builder)
     {
+        materialize();
         if (tags.contains(tag_name)) return std::nullopt;
         if (tag_type_in == tag_end) throw std::runtime_error("Attempted to create NBT list with no type.");
 
@@ -344,7 +466,7 @@ namespace melon::nbt
         try
         {
             if (builder) builder(*container);
-            const auto &[_, success] = tags.insert(std::pair{ std::string_view(*(container->name)), container.get() });
+            const auto &[_, success] = tags.insert(std::pair{ container->name.view(), container.get() });
             if (!success) [[unlikely]] throw std::runtime_error("Failed to insert NBT list.");
         } catch (...)
         {
@@ -365,6 +487,16 @@ namespace melon::nbt
 
         // Only adjust size after all recursive checks to allow strong exception guarantee.
         byte_count_v += by;
+        clean_begin = nullptr;
+    }
+
+    void list::forget_clean() noexcept
+    {
+        clean_begin = nullptr;
+
+        std::visit([](auto &&tag) {
+            if (tag != nullptr) tag->mark_dirty();
+        }, parent);
     }
 
 }
\ No newline at end of file
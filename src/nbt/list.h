@@ -5,15 +5,21 @@
 #ifndef MELON_NBT_LIST_H
 #define MELON_NBT_LIST_H
 
+#include <algorithm>
 #include <cassert>
 #include <functional>
+#include <ranges>
+#include <span>
 #include "primitive.h"
 #include "impl.h"
+#include "parser.h"
 
 namespace melon::nbt
 {
     class compound;
 
+    class list_index;
+
     class list
     {
     public:
@@ -26,68 +32,57 @@ namespace melon::nbt
         {
             friend class list;
 
-            tag_list_t::iterator itr;
+            int idx;
             list *container;
         public:
             using value_type = tag_variant_t;
             using difference_type = int;
             using iterator_category = std::random_access_iterator_tag;
 
-            generic_iterator() : itr(), container(nullptr) { };
+            generic_iterator() : idx(0), container(nullptr) { };
 
-            explicit generic_iterator(tag_list_t::iterator &itr_in, list *container_in) : itr(itr_in), container(container_in) { };
-            explicit generic_iterator(tag_list_t::iterator &&itr_in, list *container_in) : itr(itr_in), container(container_in) { };
+            explicit generic_iterator(int idx_in, list *container_in) : idx(idx_in), container(container_in) { };
 
             tag_variant_t operator*() const
-            { return fetch_value(*itr); }
-            tag_variant_t operator[](int idx) const
-            { return fetch_value(itr[idx]); }
+            { return fetch_value(idx); }
+            tag_variant_t operator[](int diff) const
+            { return fetch_value(idx + diff); }
 
-            auto &operator++() { itr++; return *this; };
+            auto &operator++() { idx++; return *this; };
             auto operator++(int)& { auto old = *this; ++(*this); return old; };
-            auto &operator--() { itr--; return *this; };
+            auto &operator--() { idx--; return *this; };
             auto operator--(int)& { auto old = *this; --(*this); return old; };
-            auto &operator+=(int diff) { itr += diff; return *this; };
-            auto &operator-=(int diff) { itr -= diff; return *this; };
+            auto &operator+=(int diff) { idx += diff; return *this; };
+            auto &operator-=(int diff) { idx -= diff; return *this; };
 
-            friend std::strong_ordering operator<=>(const generic_iterator &lhs, const generic_iterator &rhs) { return lhs.itr <=> rhs.itr; }
-            friend bool operator==(const generic_iterator &lhs, const generic_iterator &rhs) { return (lhs.itr == rhs.itr); }
+            friend std::strong_ordering operator<=>(const generic_iterator &lhs, const generic_iterator &rhs) { return lhs.idx <=> rhs.idx; }
+            friend bool operator==(const generic_iterator &lhs, const generic_iterator &rhs) { return (lhs.idx == rhs.idx); }
 
-            friend int operator-(const generic_iterator &lhs, const generic_iterator &rhs) { return rhs.itr - lhs.itr; };
-            friend generic_iterator operator+(const generic_iterator &itr_in, int diff) { return generic_iterator(itr_in.itr + diff, itr_in.container); };
-            friend generic_iterator operator-(const generic_iterator &itr_in, int diff) { return generic_iterator(itr_in.itr - diff, itr_in.container); };
+            friend int operator-(const generic_iterator &lhs, const generic_iterator &rhs) { return rhs.idx - lhs.idx; };
+            friend generic_iterator operator+(const generic_iterator &itr_in, int diff) { return generic_iterator(itr_in.idx + diff, itr_in.container); };
+            friend generic_iterator operator-(const generic_iterator &itr_in, int diff) { return generic_iterator(itr_in.idx - diff, itr_in.container); };
             friend generic_iterator operator+(int diff, const generic_iterator &itr_in) { return itr_in + diff; };
 
         private:
-            void *fetch_raw_ptr()
-            { return *itr; }
-
-            value_type fetch_value(void *value_in) const
+            value_type fetch_value(int idx_in) const
             {
                 if (container != nullptr)
-                {
-                    if (container->type() == tag_compound)
-                        return std::reference_wrapper<compound>(*static_cast<compound *>(value_in));
-                    else if (container->type() == tag_list)
-                        return std::reference_wrapper<list>(*static_cast<list *>(value_in));
-                    else
-                    {
-                        auto prim_ptr = static_cast<primitive *>(value_in);
-                        return prim_ptr->get_generic();
-                    }
-                }
+                    return container->element(idx_in);
 
                 return std::monostate();
             }
         };
 
+        // Lists of fixed size primitives are walked with a plain pointer into their packed values, and everything else through tags.
         template<tag_type_enum tag_type>
         requires (tag_type != tag_end)
         class iterator
         {
             friend class list;
 
-            tag_list_t::iterator itr;
+            using base_t = std::conditional_t<is_nbt_primitive<tag_type>, tag_prim_t<tag_type> *, tag_list_t::iterator>;
+
+            base_t itr;
             list *container;
         public:
             using value_type = tag_access_t<tag_type>;
@@ -96,13 +91,12 @@ namespace melon::nbt
 
             iterator() : itr(), container(nullptr) { };
 
-            explicit iterator(tag_list_t::iterator &itr_in, list *container_in) : itr(itr_in), container(container_in) { };
-            explicit iterator(tag_list_t::iterator &&itr_in, list *container_in) : itr(itr_in), container(container_in) { };
+            explicit iterator(base_t itr_in, list *container_in) : itr(itr_in), container(container_in) { };
 
             tag_access_t<tag_type> &operator*() const requires is_nbt_primitive<tag_type> || is_nbt_container<tag_type>
-            { return fetch_non_array_value(*itr); }
+            { return fetch_non_array_value(itr); }
             tag_access_t<tag_type> &operator[](int idx) const requires is_nbt_primitive<tag_type> || is_nbt_container<tag_type>
-            { return fetch_non_array_value(itr[idx]); }
+            { return fetch_non_array_value(itr + idx); }
 
             // Hopefully force return elision of the string_view or span generated by the primitive get() for array types
             tag_access_t<tag_type> operator*() const requires is_nbt_array<tag_type>
@@ -121,19 +115,25 @@ namespace melon::nbt
             friend bool operator==(const iterator<tag_type> &lhs, const iterator<tag_type> &rhs) { return (lhs.itr == rhs.itr); }
 
             friend int operator-(const iterator<tag_type> &lhs, const iterator<tag_type> &rhs) { return rhs.itr - lhs.itr; };
-            friend iterator<tag_type> operator+(const iterator<tag_type> &itr_in, int diff) { return iterator<tag_type>(itr_in.itr + diff); };
-            friend iterator<tag_type> operator-(const iterator<tag_type> &itr_in, int diff) { return iterator<tag_type>(itr_in.itr - diff); };
+            friend iterator<tag_type> operator+(const iterator<tag_type> &itr_in, int diff) { return iterator<tag_type>(itr_in.itr + diff, itr_in.container); };
+            friend iterator<tag_type> operator-(const iterator<tag_type> &itr_in, int diff) { return iterator<tag_type>(itr_in.itr - diff, itr_in.container); };
             friend iterator<tag_type> operator+(int diff, const iterator<tag_type> &itr_in) { return itr_in + diff; };
 
-            list::generic_iterator to_generic() { return list::generic_iterator(itr, container); }
+            list::generic_iterator to_generic()
+            {
+                if constexpr (is_nbt_primitive<tag_type>)
+                    return list::generic_iterator(static_cast<int>(itr - static_cast<tag_prim_t<tag_type> *>(container->packed_v)), container);
+                else
+                    return list::generic_iterator(static_cast<int>(itr - container->tags.begin()), container);
+            }
 
         private:
-            tag_access_t<tag_type> &fetch_non_array_value(void *ptr) const
+            tag_access_t<tag_type> &fetch_non_array_value(base_t pos) const
             {
-                if constexpr (tag_properties[tag_type].category & (cat_compound | cat_list))
-                    return *static_cast<tag_cont_t<tag_type> *>(ptr);
+                if constexpr (is_nbt_primitive<tag_type>)
+                    return *pos;
                 else
-                    return static_cast<tag_cont_t<tag_type> *>(ptr)->template get<tag_type>();
+                    return *static_cast<tag_cont_t<tag_type> *>(*pos);
             }
         };
         //@formatter:on
@@ -145,7 +145,7 @@ namespace melon::nbt
         std::pmr::memory_resource        *pmr_rsrc = std::pmr::get_default_resource();
 
     public:
-        mem::pmr::unique_ptr<std::pmr::string> name;
+        tag_name name;
 
         list() = delete;
 
@@ -155,31 +155,54 @@ namespace melon::nbt
         list(list &&) = delete;
         list &operator=(list &&) = delete;
 
+        // Anything that hands out references to primitive elements counts as a change to the list, like it does for a compound.
         // @formatter:off
         template<tag_type_enum tag_type> requires (tag_type != tag_end)
         iterator<tag_type> begin()
         {
             if (type() != tag_type) [[unlikely]] throw std::runtime_error("Attempt to create iterator of invalid NBT list type.");
-            return iterator<tag_type>(tags.begin(), this);
+            materialize();
+            if constexpr (!is_nbt_container<tag_type>) mark_dirty();
+
+            if constexpr (is_nbt_primitive<tag_type>)
+                return iterator<tag_type>(static_cast<tag_prim_t<tag_type> *>(packed_v), this);
+            else
+                return iterator<tag_type>(tags.begin(), this);
         }
 
         template<tag_type_enum tag_type> requires (tag_type != tag_end)
         iterator<tag_type> end()
         {
             if (type() != tag_type) [[unlikely]] throw std::runtime_error("Attempt to create iterator of invalid NBT list type.");
-            return iterator<tag_type>(tags.end(), this);
+            materialize();
+            if constexpr (!is_nbt_container<tag_type>) mark_dirty();
+
+            if constexpr (is_nbt_primitive<tag_type>)
+                return iterator<tag_type>(static_cast<tag_prim_t<tag_type> *>(packed_v) + packed_count, this);
+            else
+                return iterator<tag_type>(tags.end(), this);
         }
 
         generic_iterator begin()
-        { return generic_iterator(tags.begin(), this); }
+        {
+            materialize();
+            if (!holds_containers()) mark_dirty();
+            return generic_iterator(0, this);
+        }
+
         generic_iterator end()
-        { return generic_iterator(tags.end(), this); }
+        {
+            materialize();
+            if (!holds_containers()) mark_dirty();
+            return generic_iterator(static_cast<int>(size()), this);
+        }
 
         template<tag_type_enum tag_type>
         requires is_nbt_container<tag_type>
         auto &at(int idx)
         {
             if (type() != tag_type) [[unlikely]] throw std::runtime_error("Attempted access of invalid NBT list type element.");
+            materialize();
             auto cont_ptr = static_cast<tag_cont_t<tag_type> *>(tags.at(idx));
             return *cont_ptr;
         }
@@ -189,7 +212,12 @@ namespace melon::nbt
         auto &at(int idx)
         {
             if (type() != tag_type) [[unlikely]] throw std::runtime_error("Attempted access of invalid NBT list type element.");
-            return static_cast<tag_cont_t<tag_type> *>(tags.at(idx))->template get<tag_type>();
+            materialize();
+
+            if (idx < 0 || static_cast<size_t>(idx) >= packed_count) [[unlikely]] throw std::out_of_range("NBT list index out of range.");
+
+            mark_dirty();
+            return static_cast<tag_prim_t<tag_type> *>(packed_v)[idx];
         }
 
         template<tag_type_enum tag_type>
@@ -197,7 +225,11 @@ namespace melon::nbt
         auto at(int idx)
         {
             if (type() != tag_type) [[unlikely]] throw std::runtime_error("Attempted access of invalid NBT list type element.");
-            return static_cast<tag_cont_t<tag_type> *>(tags.at(idx))->template get<tag_type>();
+            materialize();
+
+            auto tag_ptr = static_cast<tag_cont_t<tag_type> *>(tags.at(idx));
+            mark_dirty();
+            return tag_ptr->template get<tag_type>();
         }
         // @formatter:on
 
@@ -223,7 +255,7 @@ namespace melon::nbt
             try
             {
                 if (builder) builder(*container);
-                tags.insert(itr.itr, static_cast<void *>(container.get()));
+                tags.insert(tags.begin() + itr.idx, static_cast<void *>(container.get()));
             } catch (...)
             {
                 adjust_byte_count(container->bytes() * -1);
@@ -242,24 +274,16 @@ namespace melon::nbt
         requires is_nbt_primitive<tag_type> && is_nbt_type_match<V, tag_type>
         void insert(const generic_iterator &itr, V &&value)
         {
-            auto tag_ptr = mem::pmr::make_unique<primitive>(pmr_rsrc, type());
-            adjust_byte_count(tag_ptr->bytes({ .full_tag = false }));
+            if (tag_type != this->type()) throw std::runtime_error("Attempt to push value of wrong type to NBT list.");
 
-            if constexpr (tag_type == tag_byte)
-                tag_ptr->value.tag_byte = value;
-            else if constexpr (tag_type == tag_short)
-                tag_ptr->value.tag_short = value;
-            else if constexpr (tag_type == tag_int)
-                tag_ptr->value.tag_int = value;
-            else if constexpr (tag_type == tag_long)
-                tag_ptr->value.tag_long = value;
-            else if constexpr (tag_type == tag_float)
-                tag_ptr->value.tag_float = value;
-            else if constexpr (tag_type == tag_double)
-                tag_ptr->value.tag_double = value;
-
-            tags.insert(itr.itr, static_cast<tag_cont_t<tag_type> *>(tag_ptr.get()));
-            static_cast<void>(tag_ptr.release());
+            grow_packed(1);
+            adjust_byte_count(sizeof(tag_prim_t<tag_type>));
+
+            auto pos = static_cast<tag_prim_t<tag_type> *>(packed_v) + itr.idx;
+
+            std::memmove(pos + 1, pos, (packed_count - itr.idx) * sizeof(tag_prim_t<tag_type>));
+            *pos = value;
+            packed_count++;
         }
 
         template<tag_type_enum tag_type, class V = tag_prim_t<tag_type>>
@@ -306,8 +330,50 @@ namespace melon::nbt
         void push(C<V, N...> &&values)
         { insert<tag_type>(end(), std::forward<C<V, N...>>(values)); }
 
+        // Views the packed values of a list of fixed size primitives. Like iterators, it's good until the list next changes size.
+        template<tag_type_enum tag_type>
+        requires is_nbt_primitive<tag_type>
+        std::span<tag_prim_t<tag_type>> as_span()
+        {
+            if (type() != tag_type) [[unlikely]] throw std::runtime_error("Attempted access of invalid NBT list type element.");
+            materialize();
+            mark_dirty();
+            return { static_cast<tag_prim_t<tag_type> *>(packed_v), packed_count };
+        }
+
+        // Replaces every value of a list of fixed size primitives at once.
+        template<tag_type_enum tag_type, std::ranges::sized_range R>
+        requires is_nbt_primitive<tag_type> && std::convertible_to<std::ranges::range_reference_t<R>, tag_prim_t<tag_type>>
+        void assign(R &&values_in)
+        {
+            using value_t = tag_prim_t<tag_type>;
+
+            if (tag_type != this->type()) throw std::runtime_error("Attempt to push value of wrong type to NBT list.");
+            materialize();
+
+            auto count_in = static_cast<size_t>(std::ranges::size(values_in));
+
+            reserve_packed(count_in);
+            adjust_byte_count((static_cast<int64_t>(count_in) - static_cast<int64_t>(packed_count)) * static_cast<int64_t>(sizeof(value_t)));
+
+            std::ranges::copy(values_in, static_cast<value_t *>(packed_v));
+            packed_count = count_in;
+        }
+
+        template<tag_type_enum tag_type>
+        requires is_nbt_primitive<tag_type>
+        void assign(std::initializer_list<tag_prim_t<tag_type>> values_in)
+        { assign<tag_type, const std::initializer_list<tag_prim_t<tag_type>> &>(values_in); }
+
         void reserve(size_t count_in)
-        { tags.reserve(count_in); }
+        {
+            materialize();
+
+            if (is_packed())
+                reserve_packed(count_in);
+            else
+                tags.reserve(count_in);
+        }
 
         [[nodiscard]] tag_type_enum type() const
         { return type_v; }
@@ -316,7 +382,16 @@ namespace melon::nbt
         { return byte_count_v; }
 
         [[nodiscard]] size_t size() const
-        { return tags.size(); }
+        {
+            // An unparsed list still knows its element count, it's the first thing in its range.
+            if (lazy_begin != nullptr)
+            {
+                auto count_itr = lazy_begin;
+                return impl::read_var<int32_t>(count_itr);
+            }
+
+            return is_packed() ? packed_count : tags.size();
+        }
 
         generic_iterator erase(const generic_iterator &pos);
         generic_iterator erase(const generic_iterator &first, const generic_iterator &last);
@@ -340,16 +415,101 @@ namespace melon::nbt
     private:
         friend class compound;
 
+        friend class parser;
+
+        friend class stream_parser;
+
+        friend class snbt_parser;
+
+        friend class tree_builder;
+
+        friend class tag_path;
+
+        friend class list_index;
+
         template<class T, class... Args>
         friend auto mem::pmr::make_obj_using_pmr(std::pmr::memory_resource *pmr_rsrc, Args &&... args)
         requires (!std::is_array_v<T>);
 
         explicit list(std::variant<compound *, list *> parent_in, std::string_view name_in, tag_type_enum tag_type_in);
-        explicit list(char **itr_in, const char *itr_end, std::variant<compound *, list *>, mem::pmr::unique_ptr<std::pmr::string> name_in, tag_type_enum tag_type_in);
+        explicit list(const impl::parse_node_args &args);
 
-        char *read(char *itr, const char *itr_end);
         void adjust_byte_count(int64_t by);
         void change_properties(impl::container_property_args props);
+        void copy_borrowed();
+
+        void materialize()
+        { if (lazy_begin != nullptr) [[unlikely]] read_lazy(); }
+
+        // Forgets the clean range of this list and of every container above it.
+        void mark_dirty() noexcept
+        { if (clean_begin != nullptr) [[unlikely]] forget_clean(); }
+
+        void forget_clean() noexcept;
+
+        // The payload as it is in the raw buffer, from the element count on, while it's still exactly that. Empty otherwise.
+        [[nodiscard]] std::span<const char> original() const noexcept
+        {
+            if (lazy_begin != nullptr) return { lazy_begin, lazy_end };
+            if (clean_begin != nullptr) return { clean_begin, clean_end };
+            return { };
+        }
+
+        [[nodiscard]] bool is_packed() const
+        { return tag_properties[type_v].category == cat_primitive; }
+
+        [[nodiscard]] bool holds_containers() const
+        { return type_v == tag_compound || type_v == tag_list; }
+
+        // Makes room for at least count_in packed values, without changing how many there are.
+        void reserve_packed(size_t count_in);
+
+        // Makes room for count_in more packed values, growing the buffer geometrically.
+        void grow_packed(size_t count_in)
+        { if (packed_count + count_in > packed_capacity) reserve_packed(std::max(packed_count + count_in, packed_capacity * 2)); }
+
+        tag_variant_t element(int idx);
+
+        // Keeps the list's indexes up to date as compounds join and leave it. If any index fails to add an element, none of them keep it.
+        void index_added(compound &element);
+        void index_removed(compound &element) noexcept;
+
+        // Makes room for count_in elements read by a parser, so they're constructed side by side. Only done while the slab is unused.
+        void reserve_slab(size_t count_in);
+
+        [[nodiscard]] bool in_slab(const void *ptr) const noexcept;
+
+        // Constructs the next element read by a parser out of the slab while there's room left in it, and on its own after that.
+        template<class T>
+        T *make_element(const impl::parse_node_args &args)
+        {
+            auto storage = next_slab_slot();
+            if (storage == nullptr) return mem::pmr::make_obj_using_pmr<T>(pmr_rsrc, args);
+
+            try
+            {
+                return ::new(storage) T(args);
+            }
+            catch (...)
+            {
+                slab_used--;
+                throw;
+            }
+        }
+
+        // Elements in the slab are only destroyed. The slab goes back to the memory resource along with the list.
+        template<class T>
+        void destroy_element(T *ptr)
+        {
+            if (in_slab(ptr))
+                std::destroy_at(ptr);
+            else
+                mem::pmr::destroy_obj_using_pmr(pmr_rsrc, ptr);
+        }
+
+        void *next_slab_slot() noexcept;
+
+        void read_lazy();
 
         void to_snbt(std::string &out) const;
         char *to_binary(char *itr) const;
@@ -367,7 +527,7 @@ namespace melon::nbt
                 array_ptr[idx++] = value;
 
             tag_ptr->value.generic_ptr = static_cast<void *>(array_ptr.get());
-            tags.insert(itr.itr, static_cast<void *>(tag_ptr.get()));
+            tags.insert(tags.begin() + itr.idx, static_cast<void *>(tag_ptr.get()));
             static_cast<void>(array_ptr.release());
             static_cast<void>(tag_ptr.release());
         }
@@ -375,9 +535,32 @@ namespace melon::nbt
         const tag_type_enum type_v = tag_end;
         tag_list_t          tags;
 
+        // Lists of fixed size primitives keep their values in native endian in one buffer, instead of a primitive per element in tags.
+        void   *packed_v        = nullptr;
+        size_t packed_count    = 0;
+        size_t packed_capacity = 0;
+
+        // Storage for the compounds or lists a parser reads into the list, so walking them touches adjacent memory. Elements added later, or
+        // past what was reserved, are allocated on their own. Slots of erased elements aren't reused until the list is empty again.
+        void   *slab_v     = nullptr;
+        size_t slab_count = 0;
+        size_t slab_used  = 0;
+
         uint16_t depth        = 0;
         size_t   byte_count_v = 0;
         int64_t  max_bytes    = -1;
+
+        // The unparsed payload of a lazily parsed list, starting at its element count. Cleared once it has been read.
+        char *lazy_begin = nullptr;
+        char *lazy_end   = nullptr;
+
+        // The same range for a list read from a buffer the tree keeps, once it has been parsed. Cleared as soon as anything below it may have
+        // changed.
+        char *clean_begin = nullptr;
+        char *clean_end   = nullptr;
+
+        // The first of the indexes built over the list, linked through each other.
+        list_index *indexes = nullptr;
     };
 
     static_assert(std::random_access_iterator<list::generic_iterator>);
@@ -385,6 +568,7 @@ namespace melon::nbt
     static_assert(std::random_access_iterator<list::iterator<tag_compound>>);
     static_assert(std::random_access_iterator<list::iterator<tag_list>>);
     static_assert(std::random_access_iterator<list::iterator<tag_int>>);
+    static_assert(std::random_access_iterator<list::iterator<tag_double>>);
     static_assert(std::random_access_iterator<list::iterator<tag_string>>);
     static_assert(std::random_access_iterator<list::iterator<tag_int_array>>);
 }
@@ -0,0 +1,155 @@
+#include "list_index.h"
+
+namespace melon::nbt
+{
+    list_index::list_index(list &target_in, std::initializer_list<std::string_view> key_paths)
+            : target_v(&target_in)
+    {
+        if (target_in.type() != tag_compound) throw std::runtime_error("NBT list index built over list that isn't of compounds.");
+        if (key_paths.size() == 0) throw std::runtime_error("NBT list index needs at least one key path.");
+
+        key_paths_v.reserve(key_paths.size());
+        for (auto key_path: key_paths)
+            key_paths_v.emplace_back(key_path);
+
+        rebuild();
+
+        next_index        = target_in.indexes;
+        target_in.indexes = this;
+    }
+
+    list_index::~list_index()
+    {
+        if (target_v == nullptr) return;
+
+        for (auto link = &target_v->indexes; *link != nullptr; link = &(*link)->next_index)
+        {
+            if (*link == this)
+            {
+                *link = next_index;
+                break;
+            }
+        }
+    }
+
+    std::optional<std::reference_wrapper<compound>> list_index::find_like(compound &probe) const
+    {
+        key_buffer key;
+        if (!read_key(probe, key)) return std::nullopt;
+
+        return find_key(key.view());
+    }
+
+    void list_index::update(compound &element)
+    {
+        removed(element);
+        added(element);
+    }
+
+    void list_index::rebuild()
+    {
+        by_key.clear();
+        by_element.clear();
+
+        if (target_v == nullptr) return;
+
+        target_v->materialize();
+        by_element.reserve(target_v->tags.size());
+
+        for (auto element: target_v->tags)
+            added(*static_cast<compound *>(element));
+    }
+
+    std::optional<std::reference_wrapper<compound>> list_index::find_key(std::string_view key) const
+    {
+        auto itr = by_key.find(key);
+        if (itr == by_key.end()) return std::nullopt;
+
+        return *itr->second.first;
+    }
+
+    bool list_index::read_key(compound &element, key_buffer &key) const
+    {
+        for (auto &key_path: key_paths_v)
+        {
+            auto found = key_path.first(std::as_const(element));
+            if (!found) return false;
+
+            bool keyable = std::visit([&key](auto &&value) {
+                using value_t = std::remove_cvref_t<decltype(value)>;
+
+                if constexpr (std::is_same_v<value_t, std::string_view>)
+                    key.append(value);
+                else if constexpr (requires { std::span(value); })
+                    key.append(std::span<const typename value_t::element_type>(value));
+                else if constexpr (requires { requires std::is_arithmetic_v<typename value_t::type>; })
+                    key.append(value.get());
+                else
+                    return false;
+
+                return true;
+            }, *found);
+
+            if (!keyable) return false;
+        }
+
+        return true;
+    }
+
+    void list_index::added(compound &element)
+    {
+        key_buffer key;
+        if (!read_key(element, key)) return;
+
+        auto [element_itr, inserted] = by_element.try_emplace(&element, entry{ .key = std::string(key.view()) });
+        if (!inserted) return;
+
+        try
+        {
+            auto [key_itr, success] = by_key.try_emplace(element_itr->second.key, chain{ .first = &element, .last = &element });
+            if (success) return;
+
+            // Later elements with the same key go on the end of the chain, so the first one in stays the one found.
+            auto last = std::exchange(key_itr->second.last, &element);
+
+            element_itr->second.prev_same           = last;
+            by_element.find(last)->second.next_same = &element;
+        }
+        catch (...)
+        {
+            by_element.erase(&element);
+            throw;
+        }
+    }
+
+    void list_index::removed(compound &element) noexcept
+    {
+        auto element_itr = by_element.find(&element);
+        if (element_itr == by_element.end()) return;
+
+        auto key_itr = by_key.find(std::string_view(element_itr->second.key));
+        auto prev    = element_itr->second.prev_same;
+        auto next    = element_itr->second.next_same;
+
+        if (prev != nullptr)
+            by_element.find(prev)->second.next_same = next;
+        else
+            key_itr->second.first = next;
+
+        if (next != nullptr)
+            by_element.find(next)->second.prev_same = prev;
+        else
+            key_itr->second.last = prev;
+
+        if (key_itr->second.first == nullptr) by_key.erase(key_itr);
+
+        by_element.erase(element_itr);
+    }
+
+    void list_index::detach() noexcept
+    {
+        by_key.clear();
+        by_element.clear();
+        target_v = nullptr;
+    }
+}
@@ -0,0 +1,168 @@
+#ifndef MELON_NBT_LIST_INDEX_H
+#define MELON_NBT_LIST_INDEX_H
+
+#include <array>
+#include <cstring>
+#include <initializer_list>
+#include <optional>
+#include <ranges>
+#include <string>
+#include <vector>
+#include "unordered_dense.h"
+#include "tag_path.h"
+
+namespace melon::nbt
+{
+    // A hash index over a list of compounds, finding elements by the values of one or more of their tags, e.g. an entity by its "UUID" or a
+    // block entity by "x", "y" and "z". Each key is a tag_path from the element, and an element is indexed under the first tag each path leads
+    // to. Elements missing any of them aren't indexed.
+    //
+    // Once built, the index follows the list: elements are indexed as they're inserted or pushed, and dropped as they're erased. Keys are read
+    // when an element joins, so changing the keyed tags of an element already in the list needs update() to be seen. If the list is destroyed
+    // first, the index is left empty.
+    //
+    // Elements can share a key. find() then returns whichever of them joined the index first and is still in the list.
+    class list_index
+    {
+    public:
+        list_index(list &target_in, std::initializer_list<std::string_view> key_paths);
+
+        list_index(const list_index &) = delete;
+        list_index &operator=(const list_index &) = delete;
+
+        list_index(list_index &&) = delete;
+        list_index &operator=(list_index &&) = delete;
+
+        ~list_index();
+
+        // Takes one value per key path, in the same order, of the type of the tag it leads to: int8_t for a byte, std::string_view for a string,
+        // a contiguous range of int32_t for an int array, and so on.
+        template<class... V>
+        [[nodiscard]] std::optional<std::reference_wrapper<compound>> find(const V &... values) const
+        {
+            if (sizeof...(V) != key_paths_v.size()) throw std::runtime_error("NBT list index lookup needs one value per key path.");
+
+            key_buffer key;
+            (key.append(values), ...);
+
+            return find_key(key.view());
+        }
+
+        // Finds an element with the same keys as probe, which needn't be in the list.
+        [[nodiscard]] std::optional<std::reference_wrapper<compound>> find_like(compound &probe) const;
+
+        // Re-reads the keys of an element that's in the list.
+        void update(compound &element);
+
+        // Indexes the whole list over again.
+        void rebuild();
+
+        // Elements indexed, not counting any left out for missing a key.
+        [[nodiscard]] size_t size() const noexcept
+        { return by_element.size(); }
+
+        [[nodiscard]] list *target() const noexcept
+        { return target_v; }
+
+    private:
+        friend class list;
+
+        // Keys are the tag type and value of each key in turn. Most are short enough to be put together without allocating.
+        class key_buffer
+        {
+        public:
+            template<class V>
+            void append(const V &value)
+            {
+                if constexpr (std::is_convertible_v<const V &, std::string_view>)
+                    append_sized(tag_string, std::string_view(value));
+                else if constexpr (std::ranges::contiguous_range<V>)
+                {
+                    using elem_t = std::remove_cv_t<std::ranges::range_value_t<V>>;
+                    static_assert(std::is_same_v<elem_t, int8_t> || std::is_same_v<elem_t, int32_t> || std::is_same_v<elem_t, int64_t>, "Unsupported NBT list index key.");
+
+                    auto type = std::is_same_v<elem_t, int8_t> ? tag_byte_array : std::is_same_v<elem_t, int32_t> ? tag_int_array : tag_long_array;
+                    append_sized(type, std::string_view(reinterpret_cast<const char *>(std::ranges::data(value)), std::ranges::size(value) * sizeof(elem_t)));
+                }
+                else
+                {
+                    // @formatter:off
+                    constexpr auto type = std::is_same_v<V, int8_t>  ? tag_byte  : std::is_same_v<V, int16_t> ? tag_short :
+                                          std::is_same_v<V, int32_t> ? tag_int   : std::is_same_v<V, int64_t> ? tag_long  :
+                                          std::is_same_v<V, float>   ? tag_float : std::is_same_v<V, double>  ? tag_double : tag_end;
+                    // @formatter:on
+                    static_assert(type != tag_end, "Unsupported NBT list index key.");
+
+                    append_bytes(type, &value, sizeof(V));
+                }
+            }
+
+            void append_sized(tag_type_enum type, std::string_view bytes)
+            {
+                auto len = static_cast<uint32_t>(bytes.size());
+                append_bytes(type, &len, sizeof(len));
+                write(bytes.data(), bytes.size());
+            }
+
+            void append_bytes(tag_type_enum type, const void *bytes, size_t count)
+            {
+                write(&type, sizeof(type));
+                write(bytes, count);
+            }
+
+            [[nodiscard]] std::string_view view() const noexcept
+            { return spill.empty() ? std::string_view(local.data(), local_len) : std::string_view(spill); }
+
+        private:
+            std::array<char, 64> local;
+            size_t               local_len = 0;
+            std::string          spill;
+
+            void write(const void *bytes, size_t count)
+            {
+                if (spill.empty() && local_len + count <= local.size())
+                {
+                    std::memcpy(local.data() + local_len, bytes, count);
+                    local_len += count;
+                    return;
+                }
+
+                if (spill.empty()) spill.assign(local.data(), local_len);
+                spill.append(static_cast<const char *>(bytes), count);
+            }
+        };
+
+        // Elements sharing a key are chained in the order they joined, both ways, so one can be added or dropped without walking the chain.
+        struct entry
+        {
+            std::string key;
+            compound    *prev_same = nullptr;
+            compound    *next_same = nullptr;
+        };
+
+        struct chain
+        {
+            compound *first;
+            compound *last;
+        };
+
+        using key_map_t = ankerl::unordered_dense::map<std::string, chain, name_hash, name_equal>;
+        using element_map_t = ankerl::unordered_dense::map<compound *, entry>;
+
+        list                  *target_v;
+        std::vector<tag_path> key_paths_v;
+        key_map_t             by_key;      // The ends of the chain of elements indexed under each key.
+        element_map_t         by_element;
+        list_index            *next_index = nullptr; // The next index over the same list.
+
+        [[nodiscard]] std::optional<std::reference_wrapper<compound>> find_key(std::string_view key) const;
+        [[nodiscard]] bool read_key(compound &element, key_buffer &key) const;
+
+        // Called by the list as its elements come and go. Removing never allocates or throws.
+        void added(compound &element);
+        void removed(compound &element) noexcept;
+        void detach() noexcept;
+    };
+}
+
+#endif //MELON_NBT_LIST_INDEX_H
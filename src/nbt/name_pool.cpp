@@ -0,0 +1,39 @@
+#include <cstring>
+#include "name_pool.h"
+
+namespace melon::nbt
+{
+    name_pool::name_pool(const allocator_type &alloc)
+            : pmr_rsrc(alloc.resource()),
+              names(alloc)
+    { }
+
+    name_pool::~name_pool()
+    {
+        for (auto name: names)
+            pmr_rsrc->deallocate(const_cast<char *>(name.data()), name.size(), alignof(char));
+    }
+
+    std::string_view name_pool::intern(std::string_view name)
+    {
+        if (name.empty()) return { };
+
+        if (auto itr = names.find(name); itr != names.end()) return *itr;
+
+        auto name_ptr = static_cast<char *>(pmr_rsrc->allocate(name.size(), alignof(char)));
+        std::memcpy(name_ptr, name.data(), name.size());
+
+        try
+        {
+            names.insert({ name_ptr, name.size() });
+        }
+        catch (...)
+        {
+            pmr_rsrc->deallocate(name_ptr, name.size(), alignof(char));
+            throw;
+        }
+
+        bytes_v += name.size();
+        return { name_ptr, name.size() };
+    }
+}
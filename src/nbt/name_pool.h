@@ -0,0 +1,48 @@
+#ifndef MELON_NBT_NAME_POOL_H
+#define MELON_NBT_NAME_POOL_H
+
+#include <memory_resource>
+#include <string_view>
+#include "unordered_dense.h"
+#include "tag_name.h"
+
+namespace melon::nbt
+{
+    // Keeps one copy of every tag name handed to it, so a tree full of "Name", "Properties", "id" and "Count" keys stores each of them once.
+    // Names taken from a pool borrow its characters, and are copied out like any other borrowed name when they leave the tree.
+    //
+    // A pool is either made by a compound for its own tree (parse_args::intern_names), or passed in by the caller to be shared by a batch of
+    // trees (parse_args::names). A shared pool has to outlive every tree parsed with it, and isn't safe to use from more than one thread.
+    class name_pool
+    {
+    public:
+        using allocator_type = std::pmr::polymorphic_allocator<>;
+
+        explicit name_pool(const allocator_type &alloc = { });
+
+        name_pool(const name_pool &) = delete;
+        name_pool &operator=(const name_pool &) = delete;
+
+        ~name_pool();
+
+        // Returns the pool's copy of name, making one the first time it's seen.
+        std::string_view intern(std::string_view name);
+
+        tag_name name_of(std::string_view name)
+        { return tag_name::borrow(intern(name)); }
+
+        [[nodiscard]] size_t size() const noexcept
+        { return names.size(); }
+
+        // Characters held, not counting the index over them.
+        [[nodiscard]] size_t bytes() const noexcept
+        { return bytes_v; }
+
+    private:
+        std::pmr::memory_resource                           *pmr_rsrc;
+        ankerl::unordered_dense::pmr::set<std::string_view> names;
+        size_t                                              bytes_v = 0;
+    };
+}
+
+#endif //MELON_NBT_NAME_POOL_H
@@ -7,6 +7,16 @@
 
 #include "nbt/compound.h"
 #include "nbt/list.h"
+#include "nbt/list_index.h"
+#include "nbt/hashed_key.h"
+#include "nbt/name_pool.h"
+#include "nbt/projection.h"
+#include "nbt/sax.h"
+#include "nbt/snbt_parser.h"
+#include "nbt/stream_parser.h"
+#include "nbt/tag_path.h"
+#include "nbt/columns.h"
+#include "nbt/validate.h"
 #include "nbt/constants.h"
 #include "nbt/types.h"
 
@@ -0,0 +1,586 @@
+#include <array>
+#include <bitset>
+#include <numeric>
+#include <span>
+#include "compound.h"
+#include "list.h"
+#include "parser.h"
+#include "util/parallel.h"
+
+// For details on the file format go to: https://minecraft.fandom.com/wiki/NBT_format#Binary_format
+
+namespace melon::nbt
+{
+    char *parser::read(compound &root, char *itr, const char *itr_end, const projection::node *keep, unsigned threads)
+    { return run(root, itr, itr_end, keep, threads); }
+
+    char *parser::read(list &root, char *itr, const char *itr_end)
+    { return run(root, itr, itr_end, nullptr, 1); }
+
+    // Every element of the list is still lazy. Each run is a slice of elements whose payloads add up to about deferred_run_bytes, and reading
+    // an element only touches the element, so the list's byte count already includes them and stays as it is. An element that fails to read
+    // is left lazy by read_lazy(), so the tree is consistent for the caller to clean up once the first exception is rethrown.
+    void parser::read_deferred(list &container, unsigned threads)
+    {
+        std::vector<size_t> run_starts{ 0 };
+        size_t              run_bytes = 0;
+
+        for (size_t idx = 0; idx < container.tags.size(); idx++)
+        {
+            if (container.type() == tag_compound)
+                run_bytes += static_cast<compound *>(container.tags[idx])->byte_count_v;
+            else
+                run_bytes += static_cast<list *>(container.tags[idx])->byte_count_v;
+
+            if (run_bytes >= deferred_run_bytes)
+            {
+                run_starts.push_back(idx + 1);
+                run_bytes = 0;
+            }
+        }
+
+        if (run_starts.back() != container.tags.size()) run_starts.push_back(container.tags.size());
+
+        util::run_parallel(run_starts.size() - 1, threads, [&container, &run_starts](size_t run) {
+            for (auto idx = run_starts[run]; idx < run_starts[run + 1]; idx++)
+            {
+                if (container.type() == tag_compound)
+                    static_cast<compound *>(container.tags[idx])->materialize();
+                else
+                    static_cast<list *>(container.tags[idx])->materialize();
+            }
+        });
+    }
+
+    namespace
+    {
+        // Forwards to the default resource and adds up what it was asked for, rounded like parser::heap_bytes() rounds.
+        class counting_resource : public std::pmr::memory_resource
+        {
+        public:
+            size_t bytes = 0;
+
+        private:
+            void *do_allocate(size_t bytes_in, size_t align_in) override
+            {
+                bytes += parser::arena_slot(bytes_in);
+                return std::pmr::get_default_resource()->allocate(bytes_in, align_in);
+            }
+
+            void do_deallocate(void *ptr, size_t bytes_in, size_t align_in) override
+            { std::pmr::get_default_resource()->deallocate(ptr, bytes_in, align_in); }
+
+            [[nodiscard]] bool do_is_equal(const std::pmr::memory_resource &other) const noexcept override
+            { return this == &other; }
+        };
+
+        // How the map's value vector and bucket array grow is up to the map. Rather than guess, a map is filled the same way the parser fills
+        // one and the allocations it makes are counted. Every step is kept, as an arena never gets old buffers back.
+        void probe_map_bytes(std::span<size_t> bytes_at)
+        {
+            counting_resource           counter;
+            std::vector<uint32_t>       keys(bytes_at.size());
+            compound::tag_list_t        tags(&counter);
+
+            std::iota(keys.begin(), keys.end(), 0);
+
+            bytes_at[0] = 0;
+            for (size_t idx = 1; idx < bytes_at.size(); idx++)
+            {
+                tags.insert(std::pair{ std::string_view(reinterpret_cast<const char *>(&keys[idx - 1]), sizeof(uint32_t)), static_cast<primitive *>(nullptr) });
+                bytes_at[idx] = counter.bytes;
+            }
+        }
+
+        size_t map_bytes(size_t entries)
+        {
+            static const auto common_sizes = [] {
+                std::array<size_t, 256> bytes_at{ };
+                probe_map_bytes(bytes_at);
+                return bytes_at;
+            }();
+
+            if (entries < common_sizes.size()) return common_sizes[entries];
+
+            std::vector<size_t> bytes_at(entries + 1);
+            probe_map_bytes(bytes_at);
+            return bytes_at.back();
+        }
+    }
+
+    size_t parser::heap_bytes(char *itr, const char *itr_end, uint16_t depth, bool borrows, bool lazy, bool interns)
+    {
+        static_assert(alignof(compound) <= arena_align && alignof(list) <= arena_align && alignof(primitive) <= arena_align);
+
+        // Mirrors what read() allocates. The compound being walked already exists, so only its map is counted. In lazy mode only its direct
+        // children are created, and they're left empty. The elements of a list of fixed size primitives are all in one buffer, which is the
+        // only thing to count for them. Likewise compounds and lists in a list are constructed in a slab that's counted with the list.
+        struct
+        {
+            bool             borrows;
+            bool             interns;
+            bool             lazy;
+            uint16_t         level       = 0;
+            size_t           bytes       = 0;
+            size_t           packed_size = 0;
+            std::bitset<514> slab;
+
+            [[nodiscard]] size_t name_bytes(std::string_view name) const noexcept
+            { return borrows || interns || name.empty() ? 0 : arena_slot(name.size()); }
+
+            void open(tag_type_enum type, std::string_view name, tag_type_enum elem_type, int32_t count) noexcept
+            {
+                if (type == tag_list && tag_properties[elem_type].category == cat_primitive) packed_size = tag_properties[elem_type].size;
+
+                auto in_slab = slab[level];
+                slab[++level] = type == tag_list && (elem_type == tag_compound || elem_type == tag_list) && count > 0;
+
+                if (level == 1 || (lazy && level > 2)) return;
+
+                if (!in_slab) bytes += arena_slot(type == tag_compound ? sizeof(compound) : sizeof(list)) + name_bytes(name);
+                if (slab[level] && !lazy) bytes += arena_slot(static_cast<size_t>(count) * (elem_type == tag_compound ? sizeof(compound) : sizeof(list)));
+            }
+
+            void close(tag_type_enum type, int32_t entries)
+            {
+                if (!lazy || level == 1)
+                {
+                    if (type == tag_compound)
+                        bytes += map_bytes(entries);
+                    else if (entries > 0)
+                        bytes += arena_slot(entries * (packed_size > 0 ? packed_size : sizeof(list::tag_list_t::value_type)));
+                }
+
+                packed_size = 0;
+                level--;
+            }
+
+            void tag(tag_type_enum type, std::string_view name, const char *, int32_t payload_len) noexcept
+            {
+                if ((lazy && level > 1) || packed_size > 0) return;
+
+                // Copied names and short copied payloads share one node with the primitive.
+                auto borrow_value = borrows && type != tag_int_array && type != tag_long_array;
+                auto embed_name   = borrows || interns ? 0 : name.size();
+                auto embed_len    = !borrow_value && primitive::embeds(type, payload_len) ? payload_len : -1;
+
+                bytes += arena_slot(primitive::node_bytes(type, embed_name, embed_len));
+
+                if (tag_properties[type].category == cat_primitive || borrow_value || embed_len >= 0)
+                    return;
+
+                bytes += arena_slot(static_cast<size_t>(payload_len) * tag_properties[type].size + padding_size);
+            }
+        } counter{ .borrows = borrows || lazy, .interns = interns, .lazy = lazy };
+
+        impl::walk_container(itr, itr_end, tag_compound, tag_end, depth, counter);
+
+        return counter.bytes;
+    }
+
+    // Every container on the stack is already in its parent, but is only added to the parent's byte count once it's closed. Until then it counts
+    // as empty plus whatever has been read into it so far. If anything throws, the open containers are closed as they are, which leaves the
+    // tree in a consistent state for the caller to clean up.
+    template<class Root>
+    char *parser::run(Root &root, char *itr, const char *const itr_end, const projection::node *keep, unsigned threads)
+    {
+        static_assert(sizeof(tag_type_enum) == sizeof(std::byte));
+
+        frame  stack[513];
+        size_t stack_size = 0;
+
+        auto top      = root.top;
+        auto pmr_rsrc = root.pmr_rsrc;
+        auto borrows  = top != nullptr && top->borrows;
+        auto names    = top != nullptr && top->state != nullptr ? top->state->names : nullptr;
+        auto lazy     = top != nullptr && top->state != nullptr && top->state->lazy;
+
+        auto bytes_of = [](const frame &entry) -> size_t & {
+            if (entry.type == tag_compound)
+                return static_cast<compound *>(entry.container)->byte_count_v;
+            else
+                return static_cast<list *>(entry.container)->byte_count_v;
+        };
+
+        auto close_frame = [&]() {
+            auto &closed = stack[--stack_size];
+            if (stack_size > 0) bytes_of(stack[stack_size - 1]) += bytes_of(closed);
+        };
+
+        // Closes a container that was read up to its end. Unless some of it was filtered out, it's exactly what's in the buffer.
+        auto finish_frame = [&]() {
+            auto &closed = stack[stack_size - 1];
+
+            if (borrows && closed.keep == nullptr)
+            {
+                if (closed.type == tag_compound)
+                {
+                    static_cast<compound *>(closed.container)->clean_begin = closed.payload;
+                    static_cast<compound *>(closed.container)->clean_end   = itr;
+                }
+                else
+                {
+                    static_cast<list *>(closed.container)->clean_begin = closed.payload;
+                    static_cast<list *>(closed.container)->clean_end   = itr;
+                }
+            }
+
+            close_frame();
+        };
+
+        auto push_compound = [&](compound *container, const projection::node *keep_tags) {
+            stack[stack_size++] = { container, tag_compound, tag_end, 0, keep_tags, false, itr };
+        };
+
+        auto push_list = [&](list *container, const projection::node *keep_tags) {
+            auto payload = itr;
+            auto count   = impl::read_var<int32_t>(itr);
+
+            if (count < 0) [[unlikely]] throw std::runtime_error("Found list with negative length while parsing binary NBT data.");
+            if (container->type() == tag_end && count > 0) [[unlikely]] throw std::runtime_error("Found populated list with no type.");
+
+            if (keep_tags != nullptr && !(tag_properties[container->type()].category & (cat_compound | cat_list)))
+            {
+                // A path can't go on past a primitive, so none of the elements can match and the list is left empty.
+                itr   = impl::skip_container(itr - sizeof(int32_t), itr_end, tag_list, container->type(), container->depth);
+                count = 0;
+            }
+            else if (container->is_packed())
+            {
+                // Fixed size values are converted straight into the list's buffer in one go.
+                auto elem_size   = tag_properties[container->type()].size;
+                auto array_bytes = static_cast<size_t>(count) * elem_size;
+
+                impl::check_payload_bounds(itr, itr_end, array_bytes);
+
+                if (count > 0)
+                {
+                    container->reserve_packed(count);
+                    util::cvt_endian_array(container->packed_v, itr, count, elem_size);
+                }
+
+                container->packed_count = count;
+                container->byte_count_v += array_bytes;
+                itr += array_bytes;
+                count = 0;
+            }
+            else
+            {
+                // Every element takes at least a byte, so a count larger than what's left of the buffer can't be honest.
+                auto honest_count = std::min(static_cast<size_t>(count), static_cast<size_t>(itr_end - itr));
+
+                container->tags.reserve(honest_count);
+                if (container->type() == tag_compound || container->type() == tag_list) container->reserve_slab(honest_count);
+            }
+
+            // A list with a single element has nothing to split, so it's left for the element's own lists.
+            auto deferred = threads != 1 && keep_tags == nullptr && (container->type() == tag_compound || container->type() == tag_list) && count > 1;
+
+            stack[stack_size++] = { container, tag_list, container->type(), count, keep_tags, deferred, payload };
+        };
+
+        // Steps over a tag that isn't wanted, starting just past its name.
+        auto skip_tag = [&](tag_type_enum tag_type, uint16_t depth) {
+            if (tag_type == tag_compound)
+                itr = impl::skip_container(itr, itr_end, tag_compound, tag_end, depth);
+            else if (tag_type == tag_list)
+            {
+                auto list_type = static_cast<tag_type_enum>(*itr++);
+                if (static_cast<uint8_t>(list_type) >= tag_properties.size()) [[unlikely]] throw std::runtime_error("Invalid NBT tag type while initializing list.");
+
+                itr = impl::skip_container(itr, itr_end, tag_list, list_type, depth);
+            }
+            else
+                itr += impl::read_payload_extent(itr, itr_end, tag_type);
+        };
+
+        auto attach = [](auto *parent, auto *tag) {
+            if constexpr (std::is_same_v<std::remove_pointer_t<decltype(parent)>, compound>)
+            {
+                const auto &[_, success] = parent->tags.insert(std::pair{ tag->name.view(), tag });
+                if (!success) throw std::runtime_error("Unable to insert NBT tag to compound (possible duplicate).");
+            }
+            else
+                parent->tags.push_back(tag);
+        };
+
+        // Destroys a container that never made it into its parent, so there is nothing to take back out of the parent's byte count.
+        auto discard = [pmr_rsrc](auto *parent, auto *container) {
+            std::visit([](auto &parent_ptr) { parent_ptr = nullptr; }, container->parent);
+
+            if constexpr (std::is_same_v<std::remove_pointer_t<decltype(parent)>, list>)
+                parent->destroy_element(container);
+            else
+                mem::pmr::destroy_obj_using_pmr(pmr_rsrc, container);
+        };
+
+        // Creates a container and either skips over its payload in lazy mode or as the element of a deferred list, or pushes it onto the stack
+        // to be read next. Containers that are only partly kept are always read, as there'd be no way to filter them later.
+        auto open_container = [&]<class T>(auto *parent, tag_name name, tag_type_enum list_type, char *tag_start, const projection::node *keep_tags, bool deferred) {
+            if (parent->depth >= 512) [[unlikely]]
+            {
+                name.release(pmr_rsrc);
+                throw std::runtime_error("NBT Depth exceeds 512.");
+            }
+
+            T *container;
+
+            try
+            {
+                impl::parse_node_args args{ .parent = parent, .top = top, .pmr_rsrc = pmr_rsrc, .name = name, .depth = static_cast<uint16_t>(parent->depth + 1),
+                                            .max_bytes = parent->max_bytes, .list_type = list_type };
+
+                if constexpr (std::is_same_v<std::remove_pointer_t<decltype(parent)>, list>)
+                    container = parent->template make_element<T>(args);
+                else
+                    container = mem::pmr::make_obj_using_pmr<T>(pmr_rsrc, args);
+            }
+            catch (...)
+            {
+                name.release(pmr_rsrc);
+                throw;
+            }
+
+            try
+            {
+                if ((lazy || deferred) && keep_tags == nullptr)
+                {
+                    constexpr auto container_type = std::is_same_v<T, compound> ? tag_compound : tag_list;
+
+                    container->lazy_end     = impl::skip_container(itr, itr_end, container_type, list_type, container->depth);
+                    container->lazy_begin   = itr;
+                    container->byte_count_v = container->lazy_end - tag_start;
+
+                    itr = container->lazy_end;
+                }
+
+                attach(parent, container);
+            }
+            catch (...)
+            {
+                discard(parent, container);
+                throw;
+            }
+
+            if ((lazy || deferred) && keep_tags == nullptr)
+                parent->byte_count_v += container->byte_count_v;
+            else
+            {
+                try
+                {
+                    if constexpr (std::is_same_v<T, compound>)
+                        push_compound(container, keep_tags);
+                    else
+                        push_list(container, keep_tags);
+                }
+                catch (...)
+                {
+                    parent->byte_count_v += container->byte_count_v;
+                    throw;
+                }
+            }
+        };
+
+        // A name or short payload that would otherwise be copied goes into the same allocation as the primitive. itr must be at the payload,
+        // whose length prefix is peeked at here and checked when the payload is read.
+        auto new_primitive = [&](tag_type_enum tag_type, std::string_view name) {
+            int32_t embed_len = -1;
+
+            if (tag_properties[tag_type].category & (cat_string | cat_array) && !(borrows && tag_type != tag_int_array && tag_type != tag_long_array) &&
+                (itr_end - itr) >= static_cast<std::ptrdiff_t>(sizeof(int32_t)))
+            {
+                auto peek = itr;
+                auto len  = tag_type == tag_string ? static_cast<int32_t>(impl::read_var<uint16_t>(peek)) : impl::read_var<int32_t>(peek);
+
+                if (primitive::embeds(tag_type, len)) embed_len = len;
+            }
+
+            if (name.empty() || borrows)
+                return std::unique_ptr<primitive, primitive_deleter>(primitive::make(pmr_rsrc, tag_type, { .name = tag_name::borrow(name), .embed_len = embed_len }), { pmr_rsrc });
+            else if (names != nullptr)
+                return std::unique_ptr<primitive, primitive_deleter>(primitive::make(pmr_rsrc, tag_type, { .name = names->name_of(name), .embed_len = embed_len }), { pmr_rsrc });
+            else
+                return std::unique_ptr<primitive, primitive_deleter>(primitive::make(pmr_rsrc, tag_type, { .embed_name = name, .embed_len = embed_len }), { pmr_rsrc });
+        };
+
+        auto read_payload = [&](primitive *tag) {
+            auto tag_type = tag->type();
+
+            if (tag_properties[tag_type].category == cat_primitive)
+                tag->value.generic = impl::read_tag_primitive(&itr, tag_type);
+            else if (tag->value_embedded)
+            {
+                // Room for the payload was made from the length prefix, which is read again here along with the bounds check.
+                auto payload_bytes = impl::read_payload_extent(itr, itr_end, tag_type);
+
+                if (tag_type == tag_string)
+                    std::memcpy(tag->value.generic_ptr, itr, payload_bytes);
+                else
+                    util::cvt_endian_array(tag->value.generic_ptr, itr, tag->size(), tag_properties[tag_type].size);
+
+                itr += payload_bytes;
+            }
+            else if (borrows && tag_type != tag_int_array && tag_type != tag_long_array)
+            {
+                // Strings and byte arrays are used exactly as they are stored, so they can point straight into the raw buffer.
+                auto [payload_ptr, payload_len] = impl::borrow_tag_payload(&itr, itr_end, tag_type);
+
+                tag->value.generic_ptr = payload_ptr;
+                tag->value_borrowed    = true;
+                tag->set_size(payload_len);
+            }
+            else if (tag_type == tag_string)
+            {
+                auto [str_ptr, str_len] = impl::read_tag_string(&itr, itr_end, pmr_rsrc);
+
+                tag->value.tag_string = str_ptr.release();
+                tag->set_size(str_len);
+            }
+            else
+            {
+                auto [array_ptr, array_len] = impl::read_tag_array(&itr, itr_end, tag_type, pmr_rsrc);
+
+                tag->value.generic_ptr = array_ptr.release();
+                tag->set_size(array_len);
+            }
+        };
+
+        try
+        {
+            if constexpr (std::is_same_v<Root, compound>)
+            {
+                root.byte_count_v += sizeof(int8_t); // END tag
+                push_compound(&root, keep);
+            }
+            else
+            {
+                root.byte_count_v += sizeof(int32_t); // Element count
+                push_list(&root, nullptr);
+            }
+
+            while (stack_size > 0)
+            {
+                auto &current = stack[stack_size - 1];
+
+                if (current.type == tag_compound)
+                {
+                    auto container = static_cast<compound *>(current.container);
+                    auto tag_start = itr;
+
+                    impl::check_entry_bounds(itr, itr_end);
+
+                    auto tag_type = static_cast<tag_type_enum>(*itr++);
+                    if (static_cast<uint8_t>(tag_type) >= tag_properties.size()) [[unlikely]] throw std::runtime_error("Invalid NBT Tag Type.");
+
+                    if (tag_type == tag_end)
+                    {
+                        finish_frame();
+                        continue;
+                    }
+
+                    auto name_len = impl::read_var<uint16_t>(itr);
+                    impl::check_name_bounds(itr, itr_end, name_len);
+
+                    const projection::node *keep_tags = nullptr;
+
+                    if (current.keep != nullptr)
+                    {
+                        auto match = current.keep->find({ itr, name_len });
+
+                        if (match == nullptr || (!match->whole && !(tag_properties[tag_type].category & (cat_compound | cat_list))))
+                        {
+                            itr += name_len;
+                            skip_tag(tag_type, container->depth + 1);
+                            continue;
+                        }
+
+                        if (!match->whole) keep_tags = match;
+                    }
+
+                    auto name_view = std::string_view{ itr, name_len };
+                    itr += name_len;
+
+                    if (tag_properties[tag_type].category & (cat_primitive | cat_string | cat_array))
+                    {
+                        auto tag_ptr = new_primitive(tag_type, name_view);
+
+                        read_payload(tag_ptr.get());
+                        attach(container, tag_ptr.get());
+                        static_cast<void>(tag_ptr.release());
+
+                        container->byte_count_v += itr - tag_start;
+                        continue;
+                    }
+
+                    auto tag_key = borrows ? tag_name::borrow(name_view) : names != nullptr ? names->name_of(name_view) : tag_name::copy_of(name_view, pmr_rsrc);
+
+                    if (tag_type == tag_compound)
+                        open_container.template operator()<compound>(container, tag_key, tag_end, tag_start, keep_tags, false);
+                    else if (tag_type == tag_list)
+                    {
+                        auto list_type = static_cast<tag_type_enum>(*itr++);
+
+                        if (static_cast<uint8_t>(list_type) >= tag_properties.size()) [[unlikely]]
+                        {
+                            tag_key.release(pmr_rsrc);
+                            throw std::runtime_error("Invalid NBT tag type while initializing list.");
+                        }
+
+                        open_container.template operator()<list>(container, tag_key, list_type, tag_start, keep_tags, false);
+                    }
+                }
+                else
+                {
+                    auto container = static_cast<list *>(current.container);
+
+                    if (current.remaining == 0)
+                    {
+                        if (current.deferred) read_deferred(*container, threads);
+
+                        finish_frame();
+                        continue;
+                    }
+
+                    current.remaining--;
+
+                    auto tag_type   = current.list_type;
+                    auto elem_start = itr;
+
+                    impl::check_element_bounds(itr, itr_end, tag_type);
+
+                    if (tag_properties[tag_type].category & (cat_compound | cat_list))
+                    {
+                        if (tag_type == tag_compound)
+                            open_container.template operator()<compound>(container, tag_name(), tag_end, elem_start, current.keep, current.deferred);
+                        else
+                        {
+                            auto list_type = static_cast<tag_type_enum>(*itr++);
+                            if (static_cast<uint8_t>(list_type) >= tag_properties.size()) [[unlikely]] throw std::runtime_error("Invalid NBT Tag Type.");
+
+                            open_container.template operator()<list>(container, tag_name(), list_type, elem_start, current.keep, current.deferred);
+                        }
+                    }
+                    else
+                    {
+                        auto tag_ptr = new_primitive(tag_type, { });
+
+                        read_payload(tag_ptr.get());
+                        attach(container, tag_ptr.get());
+                        static_cast<void>(tag_ptr.release());
+
+                        container->byte_count_v += itr - elem_start;
+                    }
+                }
+            }
+        }
+        catch (...)
+        {
+            while (stack_size > 1)
+                close_frame();
+
+            throw;
+        }
+
+        return itr;
+    }
+}
@@ -0,0 +1,70 @@
+#ifndef MELON_NBT_PARSER_H
+#define MELON_NBT_PARSER_H
+
+#include <cstddef>
+#include "constants.h"
+#include "projection.h"
+
+namespace melon::nbt
+{
+    class compound;
+
+    class list;
+
+    // Builds a compound/list/primitive tree out of binary NBT data without recursing. Nesting is tracked on an explicit stack of fixed size, so
+    // the native stack used by a parse is the same no matter how deep the input goes. Containers are handed everything they need from the
+    // tree up front instead of looking it up through their parent.
+    class parser
+    {
+    public:
+        // Reads the payload of an already constructed container, adding its tags and the bytes of its payload to it. For a compound itr must
+        // point at the type of its first tag, for a list at its element count. If keep is set, only the tags it names are added to the compound,
+        // and the rest are skipped. If the tree keeps its buffer, every container read in full is given a clean range over its payload.
+        //
+        // If threads isn't 1, lists of compounds or lists that aren't filtered by keep have their elements opened lazily as they're reached,
+        // which only skips over them, and once a list has been scanned its elements are read in runs on up to that many threads. The tree's
+        // memory resource has to be safe to use from all of them.
+        static char *read(compound &root, char *itr, const char *itr_end, const projection::node *keep = nullptr, unsigned threads = 1);
+        static char *read(list &root, char *itr, const char *itr_end);
+
+        // Walks the payload of a compound like read() would, and returns how many bytes of heap the read would take from a memory resource,
+        // counting each allocation as if it were padded out to arena_align. The payload is validated along the way, and anything read() would
+        // reject throws here as well.
+        static size_t heap_bytes(char *itr, const char *itr_end, uint16_t depth, bool borrows, bool lazy, bool interns);
+
+        // Rounds an allocation up to the alignment heap_bytes() counts it at. Nothing allocated by a parse needs more than this.
+        static constexpr size_t arena_slot(size_t bytes) noexcept
+        { return (bytes + arena_align - 1) & ~(arena_align - 1); }
+
+        static constexpr size_t arena_align = alignof(int64_t);
+
+    private:
+        struct frame
+        {
+            void          *container;
+            tag_type_enum type;
+            tag_type_enum list_type;
+            int32_t       remaining;
+
+            // What to keep of the container's tags, or of its elements' tags for a list. Everything is kept if it isn't set.
+            const projection::node *keep;
+
+            // Set on a list whose elements are opened lazily, to be read on several threads once it's closed.
+            bool deferred;
+
+            // Where the container's payload starts: its first tag, or the element count of a list. It becomes the start of the container's
+            // clean range if it's read in full from a buffer the tree keeps.
+            char *payload;
+        };
+
+        // Elements of a deferred list are handed to threads in runs of about this many bytes.
+        static constexpr size_t deferred_run_bytes = 64 * 1024;
+
+        template<class Root>
+        static char *run(Root &root, char *itr, const char *itr_end, const projection::node *keep, unsigned threads);
+
+        static void read_deferred(list &container, unsigned threads);
+    };
+}
+
+#endif //MELON_NBT_PARSER_H
@@ -7,6 +7,7 @@
 #include <cstring>
 #include "primitive.h"
 #include "snbt.h"
+#include "util/simd.h"
 
 namespace melon::nbt
 {
@@ -45,38 +46,14 @@ namespace melon::nbt
         constexpr size_t buf_len = std::numeric_limits<double>::max_digits10 + std::numeric_limits<double>::max_exponent10 + 3;
         char             buf[buf_len];
 
-        if (name != nullptr && !name->empty())
+        if (!name.empty())
         {
-            snbt::escape_string(*name, out, false);
+            snbt::escape_string(name, out, false);
             out.push_back(':');
         }
 
         if (tag_properties[type()].category == cat_primitive)
-        {
-            char                 suffix = 0;
-            std::to_chars_result res; // NOLINT(cppcoreguidelines-pro-type-member-init)
-
-            switch (type())
-            {
-                // @formatter:off
-                case tag_byte: res = std::to_chars(buf, buf + buf_len, value.tag_byte); suffix = 'b'; break;
-                case tag_short: res = std::to_chars(buf, buf + buf_len, value.tag_short); suffix = 's'; break;
-                case tag_int: res = std::to_chars(buf, buf + buf_len, value.tag_int); break;
-                case tag_long: res = std::to_chars(buf, buf + buf_len, value.tag_long); suffix = 'L'; break;
-                case tag_float: res = std::to_chars(buf, buf + buf_len, value.tag_float, std::chars_format::fixed); suffix = 'f'; break;
-                case tag_double: res = std::to_chars(buf, buf + buf_len, value.tag_double, std::chars_format::fixed); suffix = 'd'; break;
-                default: std::unreachable();
-                    // @formatter:on
-            }
-
-            if (res.ec == std::errc())
-            {
-                out.append(buf, res.ptr);
-                if (suffix) out.push_back(suffix);
-            }
-            else
-                [[unlikely]] throw std::runtime_error("Error converting NBT primitive to string: " + std::make_error_code(res.ec).message());
-        }
+            value_to_snbt(type(), &value, out);
         else if (tag_properties[type()].category == cat_array)
         {
             auto print_array = [this, &buf, &out](auto array_ptr, char suffix = 0) {
@@ -113,6 +90,43 @@ namespace melon::nbt
         }
     }
 
+    void primitive::value_to_snbt(tag_type_enum tag_type, const void *value_ptr, std::string &out)
+    {
+        // 3 = sign, decimal point, and nbt type indicator
+        constexpr size_t buf_len = std::numeric_limits<double>::max_digits10 + std::numeric_limits<double>::max_exponent10 + 3;
+        char             buf[buf_len];
+
+        auto load = [value_ptr]<class T>() {
+            T loaded;
+            std::memcpy(&loaded, value_ptr, sizeof(T));
+            return loaded;
+        };
+
+        char                 suffix = 0;
+        std::to_chars_result res; // NOLINT(cppcoreguidelines-pro-type-member-init)
+
+        switch (tag_type)
+        {
+            // @formatter:off
+            case tag_byte: res = std::to_chars(buf, buf + buf_len, load.template operator()<int8_t>()); suffix = 'b'; break;
+            case tag_short: res = std::to_chars(buf, buf + buf_len, load.template operator()<int16_t>()); suffix = 's'; break;
+            case tag_int: res = std::to_chars(buf, buf + buf_len, load.template operator()<int32_t>()); break;
+            case tag_long: res = std::to_chars(buf, buf + buf_len, load.template operator()<int64_t>()); suffix = 'L'; break;
+            case tag_float: res = std::to_chars(buf, buf + buf_len, load.template operator()<float>(), std::chars_format::fixed); suffix = 'f'; break;
+            case tag_double: res = std::to_chars(buf, buf + buf_len, load.template operator()<double>(), std::chars_format::fixed); suffix = 'd'; break;
+            default: std::unreachable();
+                // @formatter:on
+        }
+
+        if (res.ec == std::errc())
+        {
+            out.append(buf, res.ptr);
+            if (suffix) out.push_back(suffix);
+        }
+        else
+            [[unlikely]] throw std::runtime_error("Error converting NBT primitive to string: " + std::make_error_code(res.ec).message());
+    }
+
     char *primitive::to_binary(char *itr) const
     {
         switch (tag_properties[type()].category)
@@ -146,18 +160,9 @@ namespace melon::nbt
                 std::memcpy(itr, &count, sizeof(decltype(count)));
                 itr += sizeof(decltype(count));
 
-                for (int index = 0; index < size(); index++)
-                {
-                    uint64_t value_prep;
-
-                    std::memcpy(&value_prep, static_cast<char *>(value.generic_ptr) + (index * tag_properties[type()].size), sizeof(decltype(value_prep)));
-
-                    value_prep = util::cvt_endian<std::endian::little, std::endian::big>(value_prep);
-                    value_prep = util::pack_left<std::endian::little, std::endian::big>(value_prep, tag_properties[type()].size);
-
-                    std::memcpy(itr, &value_prep, tag_properties[type()].size);
-                    itr += tag_properties[type()].size;
-                }
+                // Bulk store to big endian, using whichever SIMD shuffle kernel the CPU supports.
+                util::cvt_endian_array<std::endian::native, std::endian::big>(itr, value.generic_ptr, size(), tag_properties[type()].size);
+                itr += static_cast<size_t>(size()) * tag_properties[type()].size;
 
                 return itr;
             }
@@ -165,4 +170,67 @@ namespace melon::nbt
                 std::unreachable();
         }
     }
-}
\ No newline at end of file
+
+    void primitive::release(std::pmr::memory_resource *pmr_rsrc) noexcept
+    {
+        name.release(pmr_rsrc);
+
+        if (tag_properties[type()].category & (cat_array | cat_string) && value.generic_ptr != nullptr && !value_borrowed && !value_embedded)
+            pmr_rsrc->deallocate(value.generic_ptr, size() * tag_properties[type()].size + padding_size, tag_properties[type()].size);
+
+        value.generic_ptr = nullptr;
+    }
+
+    void primitive_deleter::operator()(primitive *ptr) const noexcept
+    { primitive::destroy(ptr, pmr_rsrc); }
+
+    primitive *primitive::make(std::pmr::memory_resource *pmr_rsrc, tag_type_enum type_in, node_args args)
+    {
+        auto node_size = node_bytes(type_in, args.embed_name.size(), args.embed_len);
+        auto node      = static_cast<char *>(pmr_rsrc->allocate(node_size, alignof(primitive)));
+        auto tag_ptr   = ::new(node) primitive(type_in, 0, args.name);
+
+        // The payload goes first, as it needs the alignment the node already has. The name fills out whatever is left.
+        if (args.embed_len >= 0)
+        {
+            tag_ptr->value.generic_ptr = node + sizeof(primitive);
+            tag_ptr->value_embedded    = true;
+            tag_ptr->size_v            = args.embed_len;
+        }
+
+        if (!args.embed_name.empty())
+        {
+            auto name_ptr = node + node_size - args.embed_name.size();
+            std::memcpy(name_ptr, args.embed_name.data(), args.embed_name.size());
+            tag_ptr->name = tag_name::embed({ name_ptr, args.embed_name.size() });
+        }
+
+        return tag_ptr;
+    }
+
+    void primitive::destroy(primitive *ptr, std::pmr::memory_resource *pmr_rsrc) noexcept
+    {
+        auto name_len  = ptr->name.kind() == tag_name::storage::embedded ? ptr->name.size() : 0;
+        auto node_size = node_bytes(ptr->type(), name_len, ptr->value_embedded ? ptr->size() : -1);
+
+        ptr->release(pmr_rsrc);
+        std::destroy_at(ptr);
+        pmr_rsrc->deallocate(ptr, node_size, alignof(primitive));
+    }
+
+    void primitive::copy_borrowed(std::pmr::memory_resource *pmr_rsrc)
+    {
+        name.make_owned(pmr_rsrc);
+
+        if (value_borrowed)
+        {
+            auto value_size = size() * tag_properties[type()].size;
+            auto value_ptr  = pmr_rsrc->allocate(value_size + padding_size, tag_properties[type()].size);
+
+            std::memcpy(value_ptr, value.generic_ptr, value_size);
+
+            value.generic_ptr = value_ptr;
+            value_borrowed    = false;
+        }
+    }
+}
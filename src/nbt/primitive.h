@@ -10,9 +10,21 @@
 #include "concepts.h"
 #include "util/util.h"
 #include "mem/pmr.h"
+#include "tag_name.h"
 
 namespace melon::nbt
 {
+    class primitive;
+
+    // Owns a primitive that has not been handed to a container yet. Frees its name and any owned string or array storage along with it, the same
+    // way primitive::destroy() does.
+    struct primitive_deleter
+    {
+        std::pmr::memory_resource *pmr_rsrc;
+
+        void operator()(primitive *ptr) const noexcept;
+    };
+
     // Class does not own the pointers to held array types. This is to avoid storing the state necessary to do so with PMR.
     // Exploit the fact that no sane compiler will mess this up, despite this being the standards most idiotic instance of UB
     class primitive
@@ -22,7 +34,16 @@ namespace melon::nbt
         };
 
     public:
-        std::pmr::string *const name;
+        struct node_args : util::forced_named_init<node_args> {
+            tag_name         name{ };         // A name stored elsewhere, e.g. borrowed or interned. Ignored if embed_name isn't empty.
+            std::string_view embed_name{ };   // A name to copy into the node.
+            int32_t          embed_len = -1;  // String or array elements to make room for in the node, or -1 to leave the payload out.
+        };
+
+        // Largest string or array payload, in bytes, that is worth keeping in the same allocation as its primitive.
+        static constexpr size_t embed_max = 32;
+
+        tag_name name;
 
         union
         {
@@ -91,8 +112,8 @@ namespace melon::nbt
 
         [[nodiscard]] size_t bytes(size_params params = { .full_tag = true }) const
         {
-            size_t name_size = params.full_tag ? sizeof(int8_t) + sizeof(uint16_t) + name->size() : 0;
-            if (size() == 0)
+            size_t name_size = params.full_tag ? sizeof(int8_t) + sizeof(uint16_t) + name.size() : 0;
+            if (tag_properties[type()].category == cat_primitive)
                 return name_size + tag_properties[type()].size;
             else if (type() == tag_string)
                 return name_size + sizeof(uint16_t) + size();
@@ -106,21 +127,60 @@ namespace melon::nbt
         [[nodiscard]] int32_t size() const
         { return size_v; }
 
+        // True for a string or array payload of len elements that make() can embed.
+        static constexpr bool embeds(tag_type_enum type_in, int32_t len) noexcept
+        {
+            return (tag_properties[type_in].category & (cat_string | cat_array)) && len >= 0 &&
+                   static_cast<size_t>(len) * tag_properties[type_in].size <= embed_max;
+        }
+
+        // Bytes make() allocates for a node with an embedded name of name_len characters, and an embedded payload of embed_len elements.
+        static constexpr size_t node_bytes(tag_type_enum type_in, size_t name_len, int32_t embed_len) noexcept
+        {
+            size_t bytes = sizeof(primitive);
+
+            if (embed_len >= 0)
+                bytes += (static_cast<size_t>(embed_len) * tag_properties[type_in].size + padding_size + alignof(primitive) - 1) & ~(alignof(primitive) - 1);
+
+            return bytes + name_len;
+        }
+
+        // Allocates a primitive with its name and payload laid out after it, so a tag takes one allocation instead of up to three. An
+        // embedded payload is left for the caller to fill in, with its size already set. Anything made here must be freed with destroy().
+        static primitive *make(std::pmr::memory_resource *pmr_rsrc, tag_type_enum type_in, node_args args);
+
+        // Releases the name and value of a primitive, destroys it, and frees the node it was made in.
+        static void destroy(primitive *ptr, std::pmr::memory_resource *pmr_rsrc) noexcept;
+
     private:
         friend class list;
 
         friend class compound;
 
+        friend class parser;
+
+        friend class stream_parser;
+
+        friend class snbt_parser;
+
+        friend struct primitive_deleter;
+
         template<class T, class... Args>
         friend auto mem::pmr::make_obj_using_pmr(std::pmr::memory_resource *pmr_rsrc, Args &&... args)
         requires (!std::is_array_v<T>);
 
         const tag_type_enum type_v;
 
+        // Set when a string or array value points into the raw buffer of a compound parsed in borrowing mode instead of its own allocation.
+        bool value_borrowed = false;
+
+        // Set when a string or array value is stored in the same allocation as the primitive. Its size must not change.
+        bool value_embedded = false;
+
         // Must be set to 0 if not a string or array type
         int32_t size_v;
 
-        explicit primitive(tag_type_enum type_in = tag_byte, uint64_t value_in = 0, std::pmr::string *name_in = nullptr, size_t size_in = 0) noexcept
+        explicit primitive(tag_type_enum type_in = tag_byte, uint64_t value_in = 0, tag_name name_in = { }, size_t size_in = 0) noexcept
                 : name(name_in), type_v(type_in), size_v(size_in)
         { value.generic = value_in; }
 
@@ -128,8 +188,17 @@ namespace melon::nbt
         void set_size(int32_t new_size)
         { size_v = new_size; }
 
+        // Frees the name and any owned string or array storage. The primitive itself is left for the caller to destroy.
+        void release(std::pmr::memory_resource *pmr_rsrc) noexcept;
+
+        // Copies a borrowed name and value into storage owned by this primitive, so it no longer depends on the raw buffer it was parsed from.
+        void copy_borrowed(std::pmr::memory_resource *pmr_rsrc);
+
         void to_snbt(std::string &out) const;
         char *to_binary(char *itr) const;
+
+        // Writes a fixed size primitive stored in native endian at value_ptr, which needn't be part of a primitive (e.g. packed list values).
+        static void value_to_snbt(tag_type_enum tag_type, const void *value_ptr, std::string &out);
     };
 }
 
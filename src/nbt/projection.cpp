@@ -0,0 +1,38 @@
+#include <algorithm>
+#include "projection.h"
+
+namespace melon::nbt
+{
+    projection::projection(std::initializer_list<std::string_view> paths)
+    {
+        for (auto path: paths)
+            add(path);
+    }
+
+    void projection::add(std::string_view path)
+    {
+        auto *current = &root_v;
+
+        while (true)
+        {
+            auto split = path.find('.');
+            auto key   = path.substr(0, split);
+
+            auto found = std::ranges::find(current->children, key, &node::name);
+            auto child = found != current->children.end() ? &*found : &current->children.emplace_back(node{ .name = std::string(key) });
+
+            // A shorter path already keeps everything below this one.
+            if (child->whole) return;
+
+            if (split == std::string_view::npos)
+            {
+                child->whole = true;
+                child->children.clear();
+                return;
+            }
+
+            current = child;
+            path.remove_prefix(split + 1);
+        }
+    }
+}
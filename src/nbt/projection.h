@@ -0,0 +1,56 @@
+#ifndef MELON_NBT_PROJECTION_H
+#define MELON_NBT_PROJECTION_H
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <initializer_list>
+
+namespace melon::nbt
+{
+    // A set of dotted key paths, e.g. "Data.DragonFight.Gateways", naming the parts of a binary NBT buffer to build a tree out of. A named tag
+    // is kept with everything below it, along with the compounds leading to it. Anything else is skipped over without allocating for it. A
+    // path that leads through a list carries on into each of the list's compound elements, so their positions are kept. Tag names containing
+    // a '.' can't be named.
+    class projection
+    {
+    public:
+        struct node
+        {
+            std::string       name;
+            std::vector<node> children;
+
+            // Set when this tag is named by a path on its own, so everything below it is kept.
+            bool whole = false;
+
+            [[nodiscard]] const node *find(std::string_view name_in) const noexcept
+            {
+                for (auto &child: children)
+                    if (child.name == name_in) return &child;
+
+                return nullptr;
+            }
+        };
+
+        projection(std::initializer_list<std::string_view> paths);
+
+        template<class R>
+        requires requires(const R &range) { { *std::begin(range) } -> std::convertible_to<std::string_view>; }
+        explicit projection(const R &paths)
+        {
+            for (std::string_view path: paths)
+                add(path);
+        }
+
+        void add(std::string_view path);
+
+        // The root compound. It is never whole, as its own name isn't part of a path.
+        [[nodiscard]] const node &root() const noexcept
+        { return root_v; }
+
+    private:
+        node root_v;
+    };
+}
+
+#endif //MELON_NBT_PROJECTION_H
@@ -0,0 +1,138 @@
+#ifndef MELON_NBT_SAX_H
+#define MELON_NBT_SAX_H
+
+#include <array>
+#include <span>
+#include <string_view>
+#include "constants.h"
+#include "impl.h"
+
+namespace melon::nbt
+{
+    // Streams over a binary NBT buffer, handing each tag to a visitor as it's found instead of building a tree. Nothing is allocated, and the
+    // buffer is checked the same way a full parse checks it. As with parsing, the buffer must be padded by 8 bytes. A visitor only needs the
+    // events it cares about, and anything it leaves out is skipped:
+    //
+    //   on_compound_begin(name)                         on_byte(name, int8_t)        on_string(name, std::string_view)
+    //   on_list_begin(name, elem_type, count)           on_short(name, int16_t)      on_byte_array(name, std::span<const int8_t>, offset, count)
+    //   on_end()                                        on_int(name, int32_t)        on_int_array(name, std::span<const int32_t>, offset, count)
+    //                                                   on_long(name, int64_t)       on_long_array(name, std::span<const int64_t>, offset, count)
+    //                                                   on_float(name, float)
+    //                                                   on_double(name, double)
+    //
+    // on_end() closes both compounds and lists, starting with the root compound. Elements of a list have empty names. Names and strings point
+    // into the buffer, and strings are left as Modified UTF-8.
+    //
+    // Int and long arrays are converted to native endian in a fixed buffer on the stack, so they arrive in consecutive pieces of up to
+    // sax_array_chunk bytes. offset is the index of the first element of the piece, and count is the length of the whole array. Byte arrays
+    // need no conversion and always arrive whole. Every array causes at least one call, even when empty.
+    //
+    // Returns a pointer just past the END tag of the root compound.
+    template<class Visitor>
+    const char *visit(const char *raw, size_t raw_size, Visitor &&visitor);
+
+    constexpr static size_t sax_array_chunk = 4096;
+
+    namespace impl
+    {
+        template<class Visitor>
+        struct sax_adapter
+        {
+            Visitor &visitor;
+
+            template<class T>
+            static T read_value(const char *payload) noexcept
+            {
+                using bits_t = std::conditional_t<sizeof(T) == 1, uint8_t, std::conditional_t<sizeof(T) == 2, uint16_t, std::conditional_t<sizeof(T) == 4, uint32_t, uint64_t>>>;
+
+                auto itr = const_cast<char *>(payload);
+                return std::bit_cast<T>(read_var<bits_t>(itr));
+            }
+
+            template<class T>
+            void deliver_array(std::string_view name, const char *payload, int32_t count, auto &&handler)
+            {
+                std::array<T, sax_array_chunk / sizeof(T)> converted;
+                size_t                                     offset = 0;
+
+                do
+                {
+                    auto chunk_len = std::min(static_cast<size_t>(count) - offset, converted.size());
+
+                    util::cvt_endian_array(converted.data(), payload + offset * sizeof(T), chunk_len, sizeof(T));
+                    handler(name, std::span<const T>(converted.data(), chunk_len), offset, static_cast<size_t>(count));
+
+                    offset += chunk_len;
+                } while (offset < static_cast<size_t>(count));
+            }
+
+            void open(tag_type_enum type, std::string_view name, tag_type_enum elem_type, int32_t count)
+            {
+                if (type == tag_compound)
+                {
+                    if constexpr (requires { visitor.on_compound_begin(name); }) visitor.on_compound_begin(name);
+                }
+                else
+                {
+                    if constexpr (requires { visitor.on_list_begin(name, elem_type, count); }) visitor.on_list_begin(name, elem_type, count);
+                }
+            }
+
+            void close(tag_type_enum, int32_t)
+            {
+                if constexpr (requires { visitor.on_end(); }) visitor.on_end();
+            }
+
+            void tag(tag_type_enum type, std::string_view name, const char *payload, int32_t payload_len)
+            {
+                // @formatter:off
+                switch (type)
+                {
+                    case tag_byte:   if constexpr (requires { visitor.on_byte(name, int8_t()); }) visitor.on_byte(name, read_value<int8_t>(payload)); break;
+                    case tag_short:  if constexpr (requires { visitor.on_short(name, int16_t()); }) visitor.on_short(name, read_value<int16_t>(payload)); break;
+                    case tag_int:    if constexpr (requires { visitor.on_int(name, int32_t()); }) visitor.on_int(name, read_value<int32_t>(payload)); break;
+                    case tag_long:   if constexpr (requires { visitor.on_long(name, int64_t()); }) visitor.on_long(name, read_value<int64_t>(payload)); break;
+                    case tag_float:  if constexpr (requires { visitor.on_float(name, float()); }) visitor.on_float(name, read_value<float>(payload)); break;
+                    case tag_double: if constexpr (requires { visitor.on_double(name, double()); }) visitor.on_double(name, read_value<double>(payload)); break;
+                    case tag_string: if constexpr (requires { visitor.on_string(name, std::string_view()); }) visitor.on_string(name, std::string_view(payload, payload_len)); break;
+                    case tag_byte_array:
+                        if constexpr (requires { visitor.on_byte_array(name, std::span<const int8_t>(), size_t(), size_t()); })
+                            visitor.on_byte_array(name, std::span<const int8_t>(reinterpret_cast<const int8_t *>(payload), payload_len), size_t(0), static_cast<size_t>(payload_len));
+                        break;
+                    case tag_int_array:
+                        if constexpr (requires { visitor.on_int_array(name, std::span<const int32_t>(), size_t(), size_t()); })
+                            deliver_array<int32_t>(name, payload, payload_len, [this](auto &&... args) { visitor.on_int_array(args...); });
+                        break;
+                    case tag_long_array:
+                        if constexpr (requires { visitor.on_long_array(name, std::span<const int64_t>(), size_t(), size_t()); })
+                            deliver_array<int64_t>(name, payload, payload_len, [this](auto &&... args) { visitor.on_long_array(args...); });
+                        break;
+                    default: std::unreachable();
+                }
+                // @formatter:on
+            }
+        };
+    }
+
+    template<class Visitor>
+    const char *visit(const char *raw, size_t raw_size, Visitor &&visitor)
+    {
+        if (raw_size < 5) [[unlikely]] throw std::runtime_error("NBT Compound Tag Too Small.");
+
+        // The walk only ever reads through itr.
+        auto itr     = const_cast<char *>(raw);
+        auto itr_end = raw + raw_size;
+        if (static_cast<tag_type_enum>(*itr++) != tag_compound) [[unlikely]] throw std::runtime_error("NBT tag type not compound.");
+
+        auto name_len = impl::read_var<uint16_t>(itr);
+        impl::check_name_bounds(itr, itr_end, name_len);
+
+        std::string_view name{ itr, name_len };
+        itr += name_len;
+
+        impl::sax_adapter<std::remove_reference_t<Visitor>> adapter{ visitor };
+        return impl::walk_container(itr, itr_end, tag_compound, tag_end, 1, adapter, name);
+    }
+}
+
+#endif //MELON_NBT_SAX_H
@@ -3,7 +3,10 @@
 //
 
 #include <charconv>
+#include <cmath>
+#include <cstring>
 #include <string>
+#include <type_traits>
 #include "snbt.h"
 
 namespace melon::nbt::snbt
@@ -45,4 +48,63 @@ namespace melon::nbt::snbt
             out_str[start] = using_quote;
         }
     }
+
+    bool read_scalar(std::string_view token, scalar &out) noexcept
+    {
+        auto numeral = token;
+        if (numeral.size() > 1 && numeral.front() == '+') numeral.remove_prefix(1);
+
+        auto read_number = [&out]<class V>(std::string_view digits, tag_type_enum type) {
+            V    value;
+            auto digits_end = digits.data() + digits.size();
+
+            std::from_chars_result result; // NOLINT(cppcoreguidelines-pro-type-member-init)
+
+            if constexpr (std::is_floating_point_v<V>)
+                result = std::from_chars(digits.data(), digits_end, value, std::chars_format::general);
+            else
+                result = std::from_chars(digits.data(), digits_end, value);
+
+            if (result.ec != std::errc() || result.ptr != digits_end) return false;
+
+            if constexpr (std::is_floating_point_v<V>)
+                if (!std::isfinite(value)) return false;
+
+            out.type = type;
+            std::memcpy(&out.value, &value, sizeof(V));
+            return true;
+        };
+
+        // The suffix picks the type, and from_chars() does the range check along with the conversion.
+        if (numeral.size() > 1)
+        {
+            auto stem = numeral.substr(0, numeral.size() - 1);
+
+            switch (numeral.back() | 0x20)
+            {
+                // @formatter:off
+                case 'b': if (read_number.operator()<int8_t>(stem, tag_byte)) return true; break;
+                case 's': if (read_number.operator()<int16_t>(stem, tag_short)) return true; break;
+                case 'l': if (read_number.operator()<int64_t>(stem, tag_long)) return true; break;
+                case 'f': if (read_number.operator()<float>(stem, tag_float)) return true; break;
+                case 'd': if (read_number.operator()<double>(stem, tag_double)) return true; break;
+                default:  break;
+                // @formatter:on
+            }
+        }
+
+        if (read_number.operator()<int32_t>(numeral, tag_int)) return true;
+        if (numeral.find_first_of(".eE") != std::string_view::npos && read_number.operator()<double>(numeral, tag_double)) return true;
+
+        if (token == "true" || token == "false")
+        {
+            int8_t value = token == "true";
+
+            out.type = tag_byte;
+            std::memcpy(&out.value, &value, sizeof(value));
+            return true;
+        }
+
+        return false;
+    }
 }
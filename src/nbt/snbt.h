@@ -5,12 +5,26 @@
 #ifndef MELON_NBT_SNBT_H
 #define MELON_NBT_SNBT_H
 
+#include <cstdint>
 #include <string_view>
+#include "constants.h"
 
 namespace melon::nbt::snbt
 {
+    // A number, or true or false, read out of an unquoted token. The value is in native endian, in the first bytes of value.
+    struct scalar
+    {
+        tag_type_enum type;
+        uint64_t      value;
+    };
+
     void escape_string(const std::string_view &in_str, std::string &out_str, bool always_quote = true);
 
+    // Numbers take the usual suffixes (b, s, l, f, d, in either case), where an unsuffixed one is an int, or a double if it has a point or an
+    // exponent. true and false are bytes. Returns false for anything else, which is an unquoted string. That includes infinities and NaNs,
+    // suffixed or not, as SNBT has no way of writing them.
+    bool read_scalar(std::string_view token, scalar &out) noexcept;
+
     namespace syntax
     {
         constexpr std::string_view string_unquoted_chars  = "0123456789ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxzy+-_.";
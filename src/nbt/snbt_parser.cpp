@@ -0,0 +1,396 @@
+#include <charconv>
+#include "compound.h"
+#include "list.h"
+#include "snbt.h"
+#include "snbt_parser.h"
+#include "util/simd.h"
+
+namespace melon::nbt
+{
+    namespace
+    {
+        // The array type opened by "[B;", "[I;" or "[L;" at itr, or tag_end if it's anything else.
+        tag_type_enum array_type_at(const char *itr, const char *itr_end) noexcept
+        {
+            if (itr_end - itr < 3 || itr[2] != ';') return tag_end;
+
+            switch (itr[1])
+            {
+                // @formatter:off
+                case 'B': return tag_byte_array;
+                case 'I': return tag_int_array;
+                case 'L': return tag_long_array;
+                default:  return tag_end;
+                // @formatter:on
+            }
+        }
+    }
+
+    snbt_parser::snbt_parser(const allocator_type &alloc)
+            : pmr_rsrc(alloc.resource()),
+              tree(alloc.resource())
+    { }
+
+    mem::pmr::unique_ptr<compound> snbt_parser::read(std::string_view text)
+    {
+        itr_begin  = text.data();
+        itr        = text.data();
+        itr_end    = text.data() + text.size();
+
+        try
+        {
+            skip_space();
+
+            std::string_view name;
+
+            if (itr != itr_end && *itr != '{')
+            {
+                name = read_key();
+                skip_space();
+                expect(':');
+                skip_space();
+            }
+
+            expect('{');
+
+            tree.start(name);
+
+            while (tree.is_open())
+            {
+                auto &current = tree.top();
+                auto closer   = current.type == tag_compound ? '}' : ']';
+
+                skip_space();
+                if (itr == itr_end) [[unlikely]] fail("text ended before the root compound did");
+
+                if (*itr == closer)
+                {
+                    itr++;
+                    tree.close();
+                    continue;
+                }
+
+                // The text doesn't give a length up front, so remaining only marks whether an element has been read yet.
+                if (current.remaining > 0)
+                {
+                    if (*itr != ',') [[unlikely]] fail(current.type == tag_compound ? "expected ',' or '}'" : "expected ',' or ']'");
+
+                    itr++;
+                    skip_space();
+                }
+
+                current.remaining = 1;
+
+                if (current.type == tag_compound)
+                {
+                    auto key = read_key();
+
+                    skip_space();
+                    expect(':');
+                    skip_space();
+
+                    read_value(static_cast<compound *>(current.container), key);
+                }
+                else
+                    read_value(static_cast<list *>(current.container), { });
+            }
+
+            skip_space();
+            if (itr != itr_end) [[unlikely]] fail("found text past the end of the root compound");
+        }
+        catch (...)
+        {
+            tree.destroy();
+            throw;
+        }
+
+        return tree.release();
+    }
+
+    void snbt_parser::fail(std::string_view why) const
+    { throw std::runtime_error("Invalid SNBT at " + std::to_string(itr - itr_begin) + ": " + std::string(why) + "."); }
+
+    void snbt_parser::expect(char c)
+    {
+        if (itr == itr_end || *itr != c) [[unlikely]] fail(std::string("expected '") + c + "'");
+        itr++;
+    }
+
+    // Most strings have no escapes, so they're found in one scan and handed back as they are in the text.
+    std::string_view snbt_parser::read_quoted(std::string &scratch)
+    {
+        auto quote = *itr++;
+        auto start = itr;
+        auto stop  = util::simd::find_either(itr, itr_end, quote, snbt::syntax::string_escape_char);
+
+        if (stop == itr_end) [[unlikely]] fail("unterminated string");
+
+        if (*stop == quote)
+        {
+            itr = stop + 1;
+            return { start, stop };
+        }
+
+        scratch.assign(start, stop);
+        itr = stop;
+
+        while (*itr != quote)
+        {
+            if (++itr == itr_end) [[unlikely]] fail("unterminated string");
+            if (snbt::syntax::string_chars_to_escape.find(*itr) == std::string_view::npos) [[unlikely]] fail("invalid escape sequence");
+
+            scratch.push_back(*itr++);
+
+            stop = util::simd::find_either(itr, itr_end, quote, snbt::syntax::string_escape_char);
+            if (stop == itr_end) [[unlikely]] fail("unterminated string");
+
+            scratch.append(itr, stop);
+            itr = stop;
+        }
+
+        itr++;
+        return scratch;
+    }
+
+    std::string_view snbt_parser::read_word()
+    {
+        auto start = itr;
+
+        itr = util::simd::skip_word(itr, itr_end);
+        return { start, itr };
+    }
+
+    std::string_view snbt_parser::read_key()
+    {
+        std::string_view key;
+
+        if (itr != itr_end && (*itr == snbt::syntax::string_std_quote || *itr == snbt::syntax::string_alt_quote))
+            key = read_quoted(key_scratch);
+        else if (key = read_word(); key.empty()) [[unlikely]]
+            fail("expected a name");
+
+        if (key.size() > std::numeric_limits<uint16_t>::max()) [[unlikely]] fail("name is too long");
+
+        return key;
+    }
+
+    tag_type_enum snbt_parser::peek_type()
+    {
+        if (itr == itr_end) [[unlikely]] fail("expected a value");
+
+        switch (*itr)
+        {
+            case ']':
+                return tag_end;
+            case '{':
+                return tag_compound;
+            case '[':
+            {
+                auto array_type = array_type_at(itr, itr_end);
+                return array_type == tag_end ? tag_list : array_type;
+            }
+            case snbt::syntax::string_std_quote:
+            case snbt::syntax::string_alt_quote:
+                return tag_string;
+            default:
+            {
+                auto   token = std::string_view(itr, util::simd::skip_word(itr, itr_end));
+                snbt::scalar value{ };
+
+                if (token.empty()) [[unlikely]] fail("expected a value");
+
+                return snbt::read_scalar(token, value) ? value.type : tag_string;
+            }
+        }
+    }
+
+    template<class T>
+    void snbt_parser::read_value(T *parent, std::string_view name)
+    {
+        auto check_type = [this, parent](tag_type_enum tag_type) {
+            if constexpr (std::is_same_v<T, list>)
+                if (tag_type != parent->type()) [[unlikely]] fail("list elements must all be of the same type");
+        };
+
+        if (itr == itr_end) [[unlikely]] fail("expected a value");
+
+        switch (*itr)
+        {
+            case '{':
+            {
+                check_type(tag_compound);
+                itr++;
+
+                tree.open<compound>(parent, name, tag_end);
+                return;
+            }
+            case '[':
+            {
+                if (auto array_type = array_type_at(itr, itr_end); array_type != tag_end)
+                {
+                    check_type(array_type);
+                    itr += 3;
+
+                    read_array(parent, name, array_type);
+                    return;
+                }
+
+                check_type(tag_list);
+                itr++;
+                skip_space();
+
+                // Lists are typed as they're created, so the first element is looked at first.
+                tree.open<list>(parent, name, peek_type());
+                return;
+            }
+            case snbt::syntax::string_std_quote:
+            case snbt::syntax::string_alt_quote:
+            {
+                check_type(tag_string);
+
+                auto value = read_quoted(value_scratch);
+                if (value.size() > std::numeric_limits<uint16_t>::max()) [[unlikely]] fail("string is too long");
+
+                add_primitive(parent, tag_string, name, value.data(), value.size());
+                return;
+            }
+            default:
+            {
+                auto token = read_word();
+                if (token.empty()) [[unlikely]] fail("expected a value");
+
+                if (snbt::scalar value{ }; snbt::read_scalar(token, value))
+                {
+                    check_type(value.type);
+                    add_primitive(parent, value.type, name, &value.value, 1);
+                }
+                else
+                {
+                    check_type(tag_string);
+                    if (token.size() > std::numeric_limits<uint16_t>::max()) [[unlikely]] fail("string is too long");
+
+                    add_primitive(parent, tag_string, name, token.data(), token.size());
+                }
+            }
+        }
+    }
+
+    // Strings and arrays are count elements long, anything else is a single value in native endian.
+    template<class T>
+    void snbt_parser::add_primitive(T *parent, tag_type_enum tag_type, std::string_view name, const void *payload, size_t count)
+    {
+        auto elem_size = tag_properties[tag_type].size;
+
+        if constexpr (std::is_same_v<T, list>)
+        {
+            if (parent->is_packed())
+            {
+                parent->grow_packed(1);
+                std::memcpy(static_cast<char *>(parent->packed_v) + parent->packed_count * elem_size, payload, elem_size);
+
+                parent->packed_count++;
+                parent->byte_count_v += elem_size;
+                return;
+            }
+        }
+
+        // The name and a short payload are kept in the same allocation as the primitive.
+        auto is_sized  = tag_properties[tag_type].category != cat_primitive;
+        auto embed_len = is_sized && primitive::embeds(tag_type, static_cast<int32_t>(count)) ? static_cast<int32_t>(count) : -1;
+        auto tag_ptr   = std::unique_ptr<primitive, primitive_deleter>(primitive::make(pmr_rsrc, tag_type, { .embed_name = name, .embed_len = embed_len }), { pmr_rsrc });
+
+        if (!is_sized)
+            std::memcpy(&tag_ptr->value, payload, elem_size);
+        else
+        {
+            if (!tag_ptr->value_embedded)
+            {
+                tag_ptr->value.generic_ptr = pmr_rsrc->allocate(count * elem_size + padding_size, elem_size);
+                tag_ptr->set_size(static_cast<int32_t>(count));
+            }
+
+            if (count > 0) std::memcpy(tag_ptr->value.generic_ptr, payload, count * elem_size);
+        }
+
+        if constexpr (std::is_same_v<T, compound>)
+        {
+            const auto &[_, success] = parent->tags.insert(std::pair{ tag_ptr->name.view(), tag_ptr.get() });
+            if (!success) throw std::runtime_error("Unable to insert NBT tag to compound (possible duplicate).");
+
+            parent->byte_count_v += tag_ptr->bytes();
+        }
+        else
+        {
+            parent->tags.push_back(tag_ptr.get());
+            parent->byte_count_v += tag_ptr->bytes({ .full_tag = false });
+        }
+
+        static_cast<void>(tag_ptr.release());
+    }
+
+    // The values are gathered in native endian until the closing bracket gives their count, then copied out in one go.
+    void snbt_parser::read_array(auto *parent, std::string_view name, tag_type_enum tag_type)
+    {
+        auto elem_size = tag_properties[tag_type].size;
+        auto suffix    = tag_type == tag_byte_array ? 'b' : (tag_type == tag_long_array ? 'l' : 0);
+
+        array_scratch.clear();
+        skip_space();
+
+        if (itr != itr_end && *itr == ']')
+            itr++;
+        else
+        {
+            while (true)
+            {
+                auto token = read_word();
+
+                if (token.size() > 1 && suffix != 0 && (token.back() | 0x20) == suffix) token.remove_suffix(1);
+                if (token.size() > 1 && token.front() == '+') token.remove_prefix(1);
+
+                int64_t value;
+                auto [end, error] = std::from_chars(token.data(), token.data() + token.size(), value);
+
+                if (token.empty() || error != std::errc() || end != token.data() + token.size()) [[unlikely]] fail("expected an array element");
+
+                bool in_range = (tag_type == tag_byte_array && value >= std::numeric_limits<int8_t>::min() && value <= std::numeric_limits<int8_t>::max()) ||
+                                (tag_type == tag_int_array && value >= std::numeric_limits<int32_t>::min() && value <= std::numeric_limits<int32_t>::max()) ||
+                                tag_type == tag_long_array;
+
+                if (!in_range) [[unlikely]] fail("expected an array element");
+
+                char elem[sizeof(int64_t)];
+
+                // @formatter:off
+                switch (tag_type)
+                {
+                    case tag_byte_array: elem[0] = static_cast<char>(value); break;
+                    case tag_int_array:  { auto narrowed = static_cast<int32_t>(value); std::memcpy(elem, &narrowed, elem_size); break; }
+                    default:             std::memcpy(elem, &value, elem_size); break;
+                }
+                // @formatter:on
+
+                array_scratch.insert(array_scratch.end(), elem, elem + elem_size);
+
+                skip_space();
+                if (itr == itr_end) [[unlikely]] fail("unterminated array");
+
+                if (*itr == ']')
+                {
+                    itr++;
+                    break;
+                }
+
+                if (*itr != ',') [[unlikely]] fail("expected ',' or ']'");
+
+                itr++;
+                skip_space();
+            }
+        }
+
+        auto count = array_scratch.size() / elem_size;
+        if (count > static_cast<size_t>(std::numeric_limits<int32_t>::max())) [[unlikely]] fail("array is too long");
+
+        add_primitive(parent, tag_type, name, array_scratch.data(), count);
+    }
+}
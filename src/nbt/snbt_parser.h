@@ -0,0 +1,81 @@
+#ifndef MELON_NBT_SNBT_PARSER_H
+#define MELON_NBT_SNBT_PARSER_H
+
+#include <memory_resource>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "constants.h"
+#include "mem/pmr.h"
+#include "tree_builder.h"
+
+namespace melon::nbt
+{
+    class compound;
+
+    class list;
+
+    // Builds a compound straight out of SNBT text, e.g. what compound::to_snbt() writes, without going through any intermediate form. The
+    // root compound may be preceded by its name and a colon. Numbers take the usual suffixes (b, s, l, f, d, in either case), where an
+    // unsuffixed one is an int, or a double if it has a point or an exponent. true and false are bytes, and anything else that isn't quoted is
+    // a string. Every element of a list has to be of the same type, which is taken from the first one.
+    //
+    // Lists of fixed size values are filled in packed, and typed arrays ([B;...], [I;...], [L;...]) are read straight into their storage.
+    // Nothing is borrowed from the text, so it can go as soon as read() returns. A parser keeps its scratch space between calls, so reusing
+    // one for many documents saves allocating it each time.
+    class snbt_parser
+    {
+    public:
+        using allocator_type = std::pmr::polymorphic_allocator<>;
+
+        explicit snbt_parser(const allocator_type &alloc = { });
+
+        snbt_parser(const snbt_parser &) = delete;
+        snbt_parser &operator=(const snbt_parser &) = delete;
+
+        // Parses a whole document into a tree allocated from the parser's memory resource. Throws on malformed text, or on anything but
+        // whitespace after the root compound, and nothing of the partial tree is kept.
+        mem::pmr::unique_ptr<compound> read(std::string_view text);
+
+    private:
+        void skip_space() noexcept
+        {
+            while (itr != itr_end && (*itr == ' ' || *itr == '\t' || *itr == '\n' || *itr == '\r')) itr++;
+        }
+
+        [[noreturn]] void fail(std::string_view why) const;
+
+        void expect(char c);
+
+        // Reads a quoted string, returning a view of either the text itself or, if it had any escapes, of the unescaped copy in scratch.
+        std::string_view read_quoted(std::string &scratch);
+        std::string_view read_word();
+        std::string_view read_key();
+
+        // The type of the value at itr, without reading past it.
+        tag_type_enum peek_type();
+
+        template<class T>
+        void read_value(T *parent, std::string_view name);
+
+        template<class T>
+        void add_primitive(T *parent, tag_type_enum tag_type, std::string_view name, const void *payload, size_t count);
+
+        void read_array(auto *parent, std::string_view name, tag_type_enum tag_type);
+
+        std::pmr::memory_resource *pmr_rsrc;
+        tree_builder              tree;
+
+        const char *itr_begin = nullptr;
+        const char *itr       = nullptr;
+        const char *itr_end   = nullptr;
+
+        // Scratch space for unescaped keys and strings, and for typed arrays until their length is known. It doesn't come out of the tree's
+        // resource.
+        std::string       key_scratch;
+        std::string       value_scratch;
+        std::vector<char> array_scratch;
+    };
+}
+
+#endif //MELON_NBT_SNBT_PARSER_H
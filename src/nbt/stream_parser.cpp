@@ -0,0 +1,456 @@
+#include <algorithm>
+#include "compound.h"
+#include "list.h"
+#include "stream_parser.h"
+
+// For details on the file format go to: https://minecraft.fandom.com/wiki/NBT_format#Binary_format
+
+namespace melon::nbt
+{
+    namespace
+    {
+        template<class T>
+        T read_at(const char *itr) noexcept
+        {
+            // read_var only ever reads through its iterator.
+            auto var_itr = const_cast<char *>(itr);
+            return impl::read_var<T>(var_itr);
+        }
+
+        void check_tag_type(tag_type_enum tag_type)
+        {
+            if (static_cast<uint8_t>(tag_type) >= tag_properties.size()) [[unlikely]] throw std::runtime_error("Invalid NBT Tag Type.");
+        }
+    }
+
+    stream_parser::stream_parser(const allocator_type &alloc)
+            : pmr_rsrc(alloc.resource()),
+              tree(alloc.resource())
+    { }
+
+    mem::pmr::unique_ptr<compound> stream_parser::release()
+    {
+        if (stage_v != stage::done) [[unlikely]] throw std::runtime_error("NBT stream ended before reaching END tag of root compound.");
+
+        return tree.release();
+    }
+
+    // Every token is read out of a single contiguous run. Most of them come straight out of the piece being fed, and only a token that runs
+    // off the end of a piece is copied into carry, which is then topped up to exactly the size the token turned out to need. Array payloads
+    // are the exception, as they can be any size. They're converted into their final place as they arrive instead.
+    void stream_parser::feed(const char *data, size_t size)
+    {
+        if (stage_v == stage::failed) [[unlikely]] throw std::runtime_error("NBT stream parser can't continue after an error.");
+
+        auto itr     = data;
+        auto itr_end = data + size;
+
+        try
+        {
+            while (true)
+            {
+                if (stage_v == stage::done)
+                {
+                    if (itr != itr_end) [[unlikely]] throw std::runtime_error("Found data past the end of the NBT root compound.");
+                    break;
+                }
+
+                if (!carry.empty())
+                {
+                    if (stage_v == stage::array)
+                    {
+                        carry.erase(carry.begin(), carry.begin() + static_cast<std::ptrdiff_t>(fill_array(carry.data(), carry.size())));
+                        continue;
+                    }
+
+                    if (carry.size() < need)
+                    {
+                        auto take = std::min(need - carry.size(), static_cast<size_t>(itr_end - itr));
+
+                        carry.insert(carry.end(), itr, itr + take);
+                        itr += take;
+
+                        if (carry.size() < need) break;
+                    }
+
+                    auto used = step(carry.data(), carry.size());
+                    if (used >= 0) carry.erase(carry.begin(), carry.begin() + used);
+
+                    continue;
+                }
+
+                if (itr == itr_end) break;
+
+                if (stage_v == stage::array)
+                {
+                    itr += fill_array(itr, itr_end - itr);
+                    continue;
+                }
+
+                auto used = step(itr, itr_end - itr);
+
+                if (used >= 0)
+                    itr += used;
+                else
+                {
+                    carry.assign(itr, itr_end);
+                    itr = itr_end;
+                }
+            }
+        }
+        catch (...)
+        {
+            stage_v = stage::failed;
+            throw;
+        }
+    }
+
+    std::ptrdiff_t stream_parser::step(const char *itr, size_t avail)
+    {
+        if (stage_v == stage::root_header) return read_root_header(itr, avail);
+
+        if (tree.top().type == tag_compound)
+            return read_compound_tag(itr, avail);
+        else
+            return read_list_element(itr, avail);
+    }
+
+    std::ptrdiff_t stream_parser::read_root_header(const char *itr, size_t avail)
+    {
+        need = sizeof(tag_type_enum) + sizeof(uint16_t);
+        if (avail < need) return -1;
+
+        if (static_cast<tag_type_enum>(*itr) != tag_compound) [[unlikely]] throw std::runtime_error("NBT tag type not compound.");
+
+        need += read_at<uint16_t>(itr + sizeof(tag_type_enum));
+        if (avail < need) return -1;
+
+        // A compound created empty already counts its END tag.
+        tree.start(std::string_view(itr + sizeof(tag_type_enum) + sizeof(uint16_t), need - sizeof(tag_type_enum) - sizeof(uint16_t)));
+        stage_v = stage::tags;
+
+        return static_cast<std::ptrdiff_t>(need);
+    }
+
+    std::ptrdiff_t stream_parser::read_compound_tag(const char *itr, size_t avail)
+    {
+        auto container = static_cast<compound *>(tree.top().container);
+
+        need = sizeof(tag_type_enum);
+        if (avail < need) return -1;
+
+        auto tag_type = static_cast<tag_type_enum>(*itr);
+        check_tag_type(tag_type);
+
+        if (tag_type == tag_end)
+        {
+            if (tree.close()) stage_v = stage::done;
+            return static_cast<std::ptrdiff_t>(need);
+        }
+
+        need += sizeof(uint16_t);
+        if (avail < need) return -1;
+
+        auto name_len = read_at<uint16_t>(itr + sizeof(tag_type_enum));
+        auto head     = need + name_len;
+        auto name     = std::string_view(itr + need, name_len);
+
+        if (tag_type == tag_compound)
+        {
+            need = head;
+            if (avail < need) return -1;
+
+            open_container<compound>(container, name, tag_end, 0);
+        }
+        else if (tag_type == tag_list)
+        {
+            need = head + sizeof(tag_type_enum) + sizeof(int32_t);
+            if (avail < need) return -1;
+
+            auto list_type = static_cast<tag_type_enum>(itr[head]);
+            check_tag_type(list_type);
+
+            open_container<list>(container, name, list_type, read_at<int32_t>(itr + head + sizeof(tag_type_enum)));
+        }
+        else
+        {
+            need = head;
+            if (avail < need) return -1;
+
+            need = head + payload_need(tag_type, itr + head, avail - head);
+            if (avail < need) return -1;
+
+            read_primitive(container, tag_type, name, itr + head, need - head);
+            container->byte_count_v += head;
+        }
+
+        return static_cast<std::ptrdiff_t>(need);
+    }
+
+    std::ptrdiff_t stream_parser::read_list_element(const char *itr, size_t avail)
+    {
+        auto &current  = tree.top();
+        auto container = static_cast<list *>(current.container);
+        auto tag_type  = current.list_type;
+
+        if (current.remaining == 0)
+        {
+            if (tree.close()) stage_v = stage::done;
+            return 0;
+        }
+
+        // Elements are only counted once they're read, as a token may have to be tried again after more input arrives.
+        if (tag_type == tag_compound)
+        {
+            need = 0;
+            current.remaining--;
+
+            open_container<compound>(container, { }, tag_end, 0);
+        }
+        else if (tag_type == tag_list)
+        {
+            need = sizeof(tag_type_enum) + sizeof(int32_t);
+            if (avail < need) return -1;
+
+            auto list_type = static_cast<tag_type_enum>(*itr);
+            check_tag_type(list_type);
+
+            current.remaining--;
+            open_container<list>(container, { }, list_type, read_at<int32_t>(itr + sizeof(tag_type_enum)));
+        }
+        else
+        {
+            need = payload_need(tag_type, itr, avail);
+            if (avail < need) return -1;
+
+            current.remaining--;
+            read_primitive(container, tag_type, { }, itr, need);
+        }
+
+        return static_cast<std::ptrdiff_t>(need);
+    }
+
+    size_t stream_parser::payload_need(tag_type_enum tag_type, const char *itr, size_t avail)
+    {
+        if (tag_type == tag_string)
+            return avail < sizeof(uint16_t) ? sizeof(uint16_t) : sizeof(uint16_t) + read_at<uint16_t>(itr);
+        else if (tag_properties[tag_type].category == cat_primitive)
+            return tag_properties[tag_type].size;
+        else
+            return sizeof(int32_t);
+    }
+
+    template<class T>
+    void stream_parser::read_primitive(T *parent, tag_type_enum tag_type, std::string_view name, const char *itr, size_t payload_bytes)
+    {
+        // The name and a short payload are kept in the same allocation as the primitive. The length of an array is all that's here of it so far.
+        int32_t embed_len = -1;
+
+        if (tag_type == tag_string)
+            embed_len = static_cast<int32_t>(payload_bytes - sizeof(uint16_t));
+        else if (tag_properties[tag_type].category == cat_array)
+            embed_len = read_at<int32_t>(itr);
+
+        if (!primitive::embeds(tag_type, embed_len)) embed_len = -1;
+
+        auto tag_ptr = std::unique_ptr<primitive, primitive_deleter>(primitive::make(pmr_rsrc, tag_type, { .embed_name = name, .embed_len = embed_len }), { pmr_rsrc });
+
+        size_t array_len = 0;
+        size_t array_cap = 0;
+
+        if (tag_properties[tag_type].category == cat_primitive)
+        {
+            // read_tag_primitive() always reads 8 bytes, which may be more than the piece has.
+            char value[sizeof(uint64_t)]{ };
+            auto value_itr = value;
+
+            std::memcpy(value, itr, payload_bytes);
+            tag_ptr->value.generic = impl::read_tag_primitive(&value_itr, tag_type);
+        }
+        else if (tag_type == tag_string)
+        {
+            auto str_len = payload_bytes - sizeof(uint16_t);
+
+            if (tag_ptr->value_embedded)
+                std::memcpy(tag_ptr->value.tag_string, itr + sizeof(uint16_t), str_len);
+            else
+            {
+                auto str_ptr = mem::pmr::make_unique<char[]>(pmr_rsrc, str_len + padding_size);
+
+                std::memcpy(str_ptr.get(), itr + sizeof(uint16_t), str_len);
+
+                tag_ptr->value.tag_string = str_ptr.release();
+                tag_ptr->set_size(static_cast<int32_t>(str_len));
+            }
+        }
+        else
+        {
+            auto len = read_at<int32_t>(itr);
+            if (len < 0) [[unlikely]] throw std::runtime_error("Found array with negative length while parsing binary NBT data.");
+
+            auto elem_size = tag_properties[tag_type].size;
+            array_len = static_cast<size_t>(len);
+
+            array_cap = array_len;
+
+            if (!tag_ptr->value_embedded)
+            {
+                array_cap = std::min(array_len, initial_array_cap);
+
+                tag_ptr->value.generic_ptr = static_cast<char *>(pmr_rsrc->allocate(array_cap * elem_size + padding_size, elem_size));
+                tag_ptr->set_size(static_cast<int32_t>(array_cap));
+            }
+
+            array_v = { .owner = tag_ptr.get(), .packed = false, .byte_count = &parent->byte_count_v, .dst = static_cast<char *>(tag_ptr->value.generic_ptr), .room = array_cap, .elem_size = elem_size,
+                        .elems_left = array_len, .partial_len = 0, .partial = { } };
+        }
+
+        if constexpr (std::is_same_v<T, compound>)
+        {
+            const auto &[_, success] = parent->tags.insert(std::pair{ tag_ptr->name.view(), tag_ptr.get() });
+            if (!success) throw std::runtime_error("Unable to insert NBT tag to compound (possible duplicate).");
+        }
+        else
+            parent->tags.push_back(tag_ptr.get());
+
+        static_cast<void>(tag_ptr.release());
+
+        // The array is counted as far as its buffer goes, so the tree stays consistent while it's filled in.
+        parent->byte_count_v += payload_bytes + array_cap * tag_properties[tag_type].size;
+
+        if (array_len > 0) stage_v = stage::array;
+    }
+
+    size_t stream_parser::fill_array(const char *itr, size_t avail)
+    {
+        auto   &fill = array_v;
+        size_t used  = 0;
+
+        if (fill.partial_len > 0)
+        {
+            used = std::min(fill.elem_size - fill.partial_len, avail);
+            std::memcpy(fill.partial + fill.partial_len, itr, used);
+            fill.partial_len += used;
+
+            if (fill.partial_len < fill.elem_size) return used;
+
+            if (fill.room == 0) grow_array();
+
+            util::cvt_endian_array(fill.dst, fill.partial, 1, fill.elem_size);
+            fill.dst += fill.elem_size;
+            fill.room--;
+            fill.elems_left--;
+            fill.partial_len = 0;
+
+            if (fill.packed)
+            {
+                static_cast<list *>(fill.owner)->packed_count++;
+                *fill.byte_count += fill.elem_size;
+            }
+        }
+
+        while (fill.elems_left > 0 && avail - used >= fill.elem_size)
+        {
+            if (fill.room == 0) grow_array();
+
+            auto whole = std::min({ fill.elems_left, fill.room, (avail - used) / fill.elem_size });
+
+            util::cvt_endian_array(fill.dst, itr + used, whole, fill.elem_size);
+            fill.dst += whole * fill.elem_size;
+            fill.room -= whole;
+            fill.elems_left -= whole;
+            used += whole * fill.elem_size;
+
+            if (fill.packed)
+            {
+                static_cast<list *>(fill.owner)->packed_count += whole;
+                *fill.byte_count += whole * fill.elem_size;
+            }
+        }
+
+        if (fill.elems_left == 0)
+            stage_v = stage::tags;
+        else if (used < avail)
+        {
+            // Less than a whole element is left.
+            fill.partial_len = avail - used;
+            std::memcpy(fill.partial, itr + used, fill.partial_len);
+            used = avail;
+        }
+
+        return used;
+    }
+
+    void stream_parser::grow_array()
+    {
+        auto &fill = array_v;
+
+        // Doubling, but never past the declared length, so the buffer ends up exactly as long as the array.
+        if (fill.packed)
+        {
+            auto container = static_cast<list *>(fill.owner);
+
+            container->reserve_packed(container->packed_count + std::min(fill.elems_left, std::max<size_t>(container->packed_capacity, 1)));
+
+            fill.dst  = static_cast<char *>(container->packed_v) + container->packed_count * fill.elem_size;
+            fill.room = container->packed_capacity - container->packed_count;
+        }
+        else
+        {
+            auto tag_ptr  = static_cast<primitive *>(fill.owner);
+            auto filled   = static_cast<size_t>(tag_ptr->size());
+            auto capacity = filled + std::min(fill.elems_left, std::max<size_t>(filled, 1));
+            auto new_data = static_cast<char *>(pmr_rsrc->allocate(capacity * fill.elem_size + padding_size, fill.elem_size));
+
+            std::memcpy(new_data, tag_ptr->value.generic_ptr, filled * fill.elem_size);
+            pmr_rsrc->deallocate(tag_ptr->value.generic_ptr, filled * fill.elem_size + padding_size, fill.elem_size);
+
+            tag_ptr->value.generic_ptr = new_data;
+            tag_ptr->set_size(static_cast<int32_t>(capacity));
+            *fill.byte_count += (capacity - filled) * fill.elem_size;
+
+            fill.dst  = new_data + filled * fill.elem_size;
+            fill.room = capacity - filled;
+        }
+    }
+
+    // Lists have their length checked, and anything packed is filled in like an array once it's open.
+    template<class T>
+    void stream_parser::open_container(auto *parent, std::string_view name, tag_type_enum list_type, int32_t count)
+    {
+        if constexpr (std::is_same_v<T, list>)
+        {
+            if (count < 0) [[unlikely]] throw std::runtime_error("Found list with negative length while parsing binary NBT data.");
+            if (list_type == tag_end && count > 0) [[unlikely]] throw std::runtime_error("Found populated list with no type.");
+        }
+
+        auto container = tree.open<T>(parent, name, list_type, count);
+
+        if constexpr (std::is_same_v<T, list>)
+        {
+            if (container->is_packed() && count > 0)
+            {
+                // Fixed size values are filled in like an array, straight into the list's buffer, and counted as they arrive.
+                auto elem_size = tag_properties[list_type].size;
+
+                container->reserve_packed(std::min(static_cast<size_t>(count), initial_array_cap));
+
+                array_v = { .owner = container, .packed = true, .byte_count = &container->byte_count_v, .dst = static_cast<char *>(container->packed_v), .room = container->packed_capacity,
+                            .elem_size = elem_size, .elems_left = static_cast<size_t>(count), .partial_len = 0, .partial = { } };
+                stage_v = stage::array;
+
+                tree.top().remaining = 0;
+            }
+            else
+            {
+                // A count can't be checked against what's left of the input, so the reservation is capped by size, and the list grows past it
+                // as elements arrive.
+                auto elem_bytes   = sizeof(void *) + (list_type == tag_compound ? sizeof(compound) : list_type == tag_list ? sizeof(list) : 0);
+                auto capped_count = std::min(static_cast<size_t>(count), initial_list_bytes / elem_bytes);
+
+                container->tags.reserve(capped_count);
+                if (list_type == tag_compound || list_type == tag_list) container->reserve_slab(capped_count);
+            }
+        }
+    }
+}
@@ -0,0 +1,112 @@
+#ifndef MELON_NBT_STREAM_PARSER_H
+#define MELON_NBT_STREAM_PARSER_H
+
+#include <memory_resource>
+#include <vector>
+#include "constants.h"
+#include "mem/pmr.h"
+#include "tree_builder.h"
+
+namespace melon::nbt
+{
+    class compound;
+
+    class list;
+
+    class primitive;
+
+    // Builds a compound out of binary NBT data handed to it in pieces of any size, e.g. straight out of util::inflate_stream, so the whole
+    // buffer never has to exist at once. A tag split across pieces is put back together in a small carry buffer, except for arrays, which are
+    // converted into place as their bytes arrive. Nothing is borrowed from the input, so it can be reused as soon as feed() returns.
+    //
+    // The tree is kept consistent as it grows, so it can be destroyed at any point. If feed() throws, the parser can't be fed any more.
+    class stream_parser
+    {
+    public:
+        using allocator_type = std::pmr::polymorphic_allocator<>;
+
+        explicit stream_parser(const allocator_type &alloc = { });
+
+        stream_parser(const stream_parser &) = delete;
+        stream_parser &operator=(const stream_parser &) = delete;
+
+        // Parses as much as it can of what it's been given so far. Throws on malformed data, or on anything after the root compound's END tag.
+        void feed(const char *data, size_t size);
+
+        // True once the root compound's END tag has been read.
+        [[nodiscard]] bool done() const noexcept
+        { return stage_v == stage::done; }
+
+        // Hands over the finished tree, allocated from the parser's memory resource. Throws if the root compound isn't finished.
+        mem::pmr::unique_ptr<compound> release();
+
+    private:
+        enum class stage : uint8_t
+        {
+            root_header,
+            tags,
+            array,
+            done,
+            failed
+        };
+
+        // An array being filled in as its bytes come in. An element split across pieces is held in partial until it's complete. A declared
+        // length can't be checked against what's left of the input, so the buffer starts out capped and grows as elements arrive. room is how
+        // many more fit before it has to. byte_count is the count that grows with it, the parent's for an array and the list's own for a packed
+        // list, so the tree stays consistent if it's torn down part way through.
+        struct array_fill
+        {
+            void     *owner;
+            bool     packed;
+            size_t   *byte_count;
+            char     *dst;
+            size_t   room;
+            size_t   elem_size;
+            size_t   elems_left;
+            size_t   partial_len;
+            char     partial[sizeof(int64_t)];
+        };
+
+        // The most elements an array or packed list is allocated for before any of them have been read.
+        static constexpr size_t initial_array_cap = 65536;
+
+        // The most bytes a list of anything else is allocated before any of its elements have been read. Unlike arrays, these nest, so a
+        // reservation per open list adds up. Elements past it are allocated on their own.
+        static constexpr size_t initial_list_bytes = 16384;
+
+        // Tries to read the next token out of a contiguous run of bytes. Returns how many bytes were used, or -1 after setting need to the
+        // number of bytes the token is known to take so far.
+        std::ptrdiff_t step(const char *itr, size_t avail);
+        std::ptrdiff_t read_root_header(const char *itr, size_t avail);
+        std::ptrdiff_t read_compound_tag(const char *itr, size_t avail);
+        std::ptrdiff_t read_list_element(const char *itr, size_t avail);
+
+        // How many bytes of a payload have to be available before it can be read. For strings that depends on their length, so it goes up
+        // once the length is available. Arrays are filled in separately, so only their length counts.
+        static size_t payload_need(tag_type_enum tag_type, const char *itr, size_t avail);
+
+        // Creates a tag out of a payload that's entirely available, or sets up an array to be filled in, and adds it to parent. Only the payload
+        // is added to the parent's byte count.
+        template<class T>
+        void read_primitive(T *parent, tag_type_enum tag_type, std::string_view name, const char *itr, size_t payload_bytes);
+
+        size_t fill_array(const char *itr, size_t avail);
+        void   grow_array();
+
+        template<class T>
+        void open_container(auto *parent, std::string_view name, tag_type_enum list_type, int32_t count);
+
+        std::pmr::memory_resource *pmr_rsrc;
+        tree_builder              tree;
+
+        stage  stage_v = stage::root_header;
+        size_t need    = 1;
+
+        array_fill array_v{ };
+
+        // Holds the start of a token that didn't fit in the last piece. It's scratch space, so it doesn't come out of the tree's resource.
+        std::vector<char> carry;
+    };
+}
+
+#endif //MELON_NBT_STREAM_PARSER_H
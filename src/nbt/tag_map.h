@@ -0,0 +1,212 @@
+#ifndef MELON_NBT_TAG_MAP_H
+#define MELON_NBT_TAG_MAP_H
+
+#include <algorithm>
+#include <cstring>
+#include <limits>
+#include <memory>
+#include <memory_resource>
+#include <span>
+#include <string_view>
+#include <utility>
+#include "unordered_dense.h"
+#include "hashed_key.h"
+
+namespace melon::nbt
+{
+    // The key to tag map behind a compound. Most compounds are tiny (palette entries, item stacks, positions), so the first inline_capacity
+    // tags are kept in an array inside the map itself and found by a linear scan, with no allocation at all. Adding one more tag moves them
+    // all into a dense hash map in the same storage, and the map stays that way until it's destroyed.
+    //
+    // Either way the tags sit side by side in one array, so iterators are plain pointers into it. Erasing moves the last tag into the gap,
+    // so it invalidates iterators to the last tag as well as the erased one. Promotion invalidates every iterator.
+    template<class T, size_t inline_capacity = 8>
+    class tag_map
+    {
+    public:
+        using key_type = std::string_view;
+        using mapped_type = T;
+        using value_type = std::pair<std::string_view, T>;
+        using allocator_type = std::pmr::polymorphic_allocator<value_type>;
+        using iterator = value_type *;
+        using const_iterator = const value_type *;
+
+        using hash_map_t = ankerl::unordered_dense::pmr::map<std::string_view, T, name_hash, name_equal>;
+        static_assert(std::is_same_v<typename hash_map_t::value_type, value_type>);
+
+        explicit tag_map(std::pmr::memory_resource *pmr_rsrc_in) noexcept
+                : pmr_rsrc(pmr_rsrc_in)
+        { }
+
+        tag_map(const tag_map &) = delete;
+        tag_map &operator=(const tag_map &) = delete;
+
+        ~tag_map()
+        {
+            if (promoted())
+                std::destroy_at(&storage.hashed);
+            else
+                std::destroy_n(storage.flat, flat_size);
+        }
+
+        [[nodiscard]] bool promoted() const noexcept
+        { return flat_size == promoted_marker; }
+
+        [[nodiscard]] allocator_type get_allocator() const noexcept
+        { return allocator_type(pmr_rsrc); }
+
+        [[nodiscard]] size_t size() const noexcept
+        { return promoted() ? storage.hashed.size() : flat_size; }
+
+        [[nodiscard]] bool empty() const noexcept
+        { return size() == 0; }
+
+        iterator begin() noexcept
+        { return promoted() ? const_cast<iterator>(storage.hashed.values().data()) : storage.flat; }
+
+        iterator end() noexcept
+        { return begin() + size(); }
+
+        const_iterator begin() const noexcept
+        { return promoted() ? storage.hashed.values().data() : storage.flat; }
+
+        const_iterator end() const noexcept
+        { return begin() + size(); }
+
+        const_iterator cbegin() const noexcept
+        { return begin(); }
+
+        const_iterator cend() const noexcept
+        { return end(); }
+
+        iterator find(std::string_view key) noexcept
+        {
+            if (promoted())
+            {
+                auto itr = storage.hashed.find(key);
+                return begin() + (itr - storage.hashed.begin());
+            }
+
+            return storage.flat + flat_index(key);
+        }
+
+        const_iterator find(std::string_view key) const noexcept
+        { return const_cast<tag_map *>(this)->find(key); }
+
+        // Inline tags are scanned by name as usual, so the key's hash is only used once the map has been promoted.
+        iterator find(const hashed_key &key) noexcept
+        {
+            if (promoted())
+            {
+                auto itr = storage.hashed.find(key);
+                return begin() + (itr - storage.hashed.begin());
+            }
+
+            return storage.flat + flat_index(key.view());
+        }
+
+        const_iterator find(const hashed_key &key) const noexcept
+        { return const_cast<tag_map *>(this)->find(key); }
+
+        [[nodiscard]] bool contains(std::string_view key) const noexcept
+        { return find(key) != end(); }
+
+        [[nodiscard]] bool contains(const hashed_key &key) const noexcept
+        { return find(key) != end(); }
+
+        // Never replaces an existing tag, like std::unordered_map::insert.
+        std::pair<iterator, bool> insert(const value_type &value)
+        {
+            if (promoted())
+            {
+                auto [itr, success] = storage.hashed.insert(value);
+                return { begin() + (itr - storage.hashed.begin()), success };
+            }
+
+            if (auto idx = flat_index(value.first); idx < flat_size) return { storage.flat + idx, false };
+
+            if (flat_size == inline_capacity)
+            {
+                promote(inline_capacity + 1);
+                return insert(value);
+            }
+
+            std::construct_at(storage.flat + flat_size, value);
+            return { storage.flat + flat_size++, true };
+        }
+
+        iterator erase(const_iterator pos)
+        {
+            auto idx = pos - begin();
+
+            if (promoted())
+                storage.hashed.erase(storage.hashed.begin() + idx);
+            else
+            {
+                auto last = storage.flat + --flat_size;
+                if (storage.flat + idx != last) storage.flat[idx] = std::move(*last);
+                std::destroy_at(last);
+            }
+
+            return begin() + idx;
+        }
+
+        // Promotes up front if count won't fit inline, so the inserts that follow can't fail to allocate.
+        void reserve(size_t count)
+        {
+            if (promoted())
+                storage.hashed.reserve(count);
+            else if (count > inline_capacity)
+                promote(count);
+        }
+
+    private:
+        static constexpr uint8_t promoted_marker = std::numeric_limits<uint8_t>::max();
+        static_assert(inline_capacity < promoted_marker);
+
+        // Names are short and mostly differ in length, so that's compared before any characters are. Interned names are found by address.
+        [[nodiscard]] size_t flat_index(std::string_view key) const noexcept
+        {
+            size_t idx = 0;
+
+            for (; idx < flat_size; idx++)
+            {
+                const auto &flat_key = storage.flat[idx].first;
+                if (flat_key.size() == key.size() && (flat_key.data() == key.data() || key.empty() || std::memcmp(flat_key.data(), key.data(), key.size()) == 0)) break;
+            }
+
+            return idx;
+        }
+
+        // The hash map is filled on the side first, so a failed allocation leaves the inline tags as they were.
+        void promote(size_t count)
+        {
+            hash_map_t hashed{ allocator_type(pmr_rsrc) };
+            hashed.reserve(std::max(count, static_cast<size_t>(flat_size)));
+
+            for (auto &value: std::span(storage.flat, flat_size))
+                hashed.insert(value);
+
+            std::destroy_n(storage.flat, flat_size);
+            std::construct_at(&storage.hashed, std::move(hashed));
+            flat_size = promoted_marker;
+        }
+
+        union storage_t
+        {
+            storage_t() noexcept
+            { }
+
+            ~storage_t()
+            { }
+
+            value_type flat[inline_capacity];
+            hash_map_t hashed;
+        } storage;
+
+        std::pmr::memory_resource *pmr_rsrc;
+        uint8_t                   flat_size = 0;
+    };
+}
+
+#endif //MELON_NBT_TAG_MAP_H
@@ -0,0 +1,92 @@
+#ifndef MELON_NBT_TAG_NAME_H
+#define MELON_NBT_TAG_NAME_H
+
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <stdexcept>
+#include <string_view>
+#include <memory_resource>
+
+namespace melon::nbt
+{
+    // A tag name is a view that either owns its characters, or borrows them from storage owned by the tree (e.g. the raw buffer of a
+    // compound parsed in borrowing mode, or a name_pool). It may also be embedded in the same allocation as its primitive, which frees it
+    // along with itself. Like primitive, it does not store the memory resource needed to free itself, so its owner must release it.
+    class tag_name
+    {
+    public:
+        enum class storage : uint8_t
+        {
+            owned,
+            borrowed,
+            embedded
+        };
+
+        tag_name() noexcept = default;
+
+        static tag_name copy_of(std::string_view name_in, std::pmr::memory_resource *pmr_rsrc)
+        {
+            if (name_in.empty()) return { };
+            if (name_in.size() > std::numeric_limits<uint16_t>::max()) [[unlikely]]
+                throw std::runtime_error("NBT tag name too long.");
+
+            auto name_ptr = static_cast<char *>(pmr_rsrc->allocate(name_in.size(), alignof(char)));
+            std::memcpy(name_ptr, name_in.data(), name_in.size());
+
+            return { name_ptr, static_cast<uint16_t>(name_in.size()), storage::owned };
+        }
+
+        static tag_name borrow(std::string_view name_in) noexcept
+        { return { name_in.data(), static_cast<uint16_t>(name_in.size()), storage::borrowed }; }
+
+        // For characters stored right after the primitive that owns the name. Releasing it frees nothing.
+        static tag_name embed(std::string_view name_in) noexcept
+        { return { name_in.data(), static_cast<uint16_t>(name_in.size()), storage::embedded }; }
+
+        // Frees owned characters and leaves an empty name behind.
+        void release(std::pmr::memory_resource *pmr_rsrc) noexcept
+        {
+            if (kind_v == storage::owned && size_v > 0)
+                pmr_rsrc->deallocate(const_cast<char *>(data_v), size_v, alignof(char));
+
+            *this = tag_name();
+        }
+
+        // Replaces borrowed characters with an owned copy. Owned and embedded names are left alone.
+        void make_owned(std::pmr::memory_resource *pmr_rsrc)
+        {
+            if (kind_v == storage::borrowed)
+                *this = copy_of(view(), pmr_rsrc);
+        }
+
+        [[nodiscard]] std::string_view view() const noexcept
+        { return { data_v, size_v }; }
+
+        operator std::string_view() const noexcept // NOLINT(google-explicit-constructor)
+        { return view(); }
+
+        [[nodiscard]] const char *data() const noexcept
+        { return data_v; }
+
+        [[nodiscard]] size_t size() const noexcept
+        { return size_v; }
+
+        [[nodiscard]] bool empty() const noexcept
+        { return size_v == 0; }
+
+        [[nodiscard]] storage kind() const noexcept
+        { return kind_v; }
+
+    private:
+        tag_name(const char *data_in, uint16_t size_in, storage kind_in) noexcept
+                : data_v(data_in), size_v(size_in), kind_v(kind_in)
+        { }
+
+        const char *data_v = nullptr;
+        uint16_t   size_v  = 0;
+        storage    kind_v  = storage::owned;
+    };
+}
+
+#endif //MELON_NBT_TAG_NAME_H
@@ -0,0 +1,398 @@
+#include <charconv>
+#include <cstring>
+#include <limits>
+#include "tag_path.h"
+#include "snbt.h"
+
+namespace melon::nbt
+{
+    // Reads the text of a path into its ops and filters. Names and strings are unescaped into the path's name buffer, which can't need more room
+    // than the text they came from.
+    class tag_path_compiler
+    {
+    public:
+        tag_path_compiler(tag_path &path_in, std::string_view text_in)
+                : path(path_in), text(text_in), names_itr(path_in.names.get())
+        { }
+
+        void compile()
+        {
+            if (text.empty()) fail("it's empty");
+
+            if (peek() == '{')
+                add_filter(tag_path::op_code::filter);
+            else
+                add_child();
+
+            while (pos < text.size())
+            {
+                if (peek() == '.')
+                {
+                    pos++;
+                    add_child();
+                }
+                else if (peek() == '{' && path.ops.back().code == tag_path::op_code::child)
+                    add_filter(tag_path::op_code::filter);
+                else if (peek() == '[')
+                    add_elements();
+                else
+                    fail("unexpected character");
+            }
+        }
+
+    private:
+        tag_path         &path;
+        std::string_view text;
+        size_t           pos = 0;
+        char             *names_itr;
+
+        [[noreturn]] void fail(std::string_view why) const
+        { throw std::runtime_error("Invalid NBT path \"" + std::string(text) + "\" at " + std::to_string(pos) + ": " + std::string(why) + "."); }
+
+        [[nodiscard]] char peek() const noexcept
+        { return pos < text.size() ? text[pos] : '\0'; }
+
+        void expect(char c)
+        {
+            if (peek() != c) fail(std::string("expected '") + c + "'");
+            pos++;
+        }
+
+        void skip_space()
+        { while (peek() == ' ' || peek() == '\t' || peek() == '\n' || peek() == '\r') pos++; }
+
+        // Copies chars into the name buffer, and returns a view of the copy.
+        std::string_view store(std::string_view chars)
+        {
+            auto start = names_itr;
+            names_itr = std::copy(chars.begin(), chars.end(), names_itr);
+            return { start, chars.size() };
+        }
+
+        std::string_view read_quoted()
+        {
+            auto quote = text[pos++];
+            auto start = names_itr;
+
+            while (true)
+            {
+                if (pos >= text.size()) fail("unterminated quote");
+
+                auto c = text[pos++];
+
+                if (c == quote) break;
+
+                if (c == snbt::syntax::string_escape_char)
+                {
+                    if (pos >= text.size() || snbt::syntax::string_chars_to_escape.find(text[pos]) == std::string_view::npos) fail("invalid escape");
+                    c = text[pos++];
+                }
+
+                *names_itr++ = c;
+            }
+
+            return { start, static_cast<size_t>(names_itr - start) };
+        }
+
+        std::string_view read_unquoted(auto &&allowed)
+        {
+            auto start = pos;
+            while (pos < text.size() && allowed(text[pos])) pos++;
+
+            return text.substr(start, pos - start);
+        }
+
+        std::string_view read_name()
+        {
+            if (peek() == snbt::syntax::string_std_quote || peek() == snbt::syntax::string_alt_quote) return read_quoted();
+
+            auto name = read_unquoted([](char c) { return std::string_view(" \t\r\n\"'[].{}").find(c) == std::string_view::npos; });
+            if (name.empty()) fail("expected a name");
+
+            return store(name);
+        }
+
+        void add_child()
+        {
+            auto name = read_name();
+            if (name.size() > std::numeric_limits<uint16_t>::max()) fail("name is too long");
+
+            path.ops.push_back({ .code = tag_path::op_code::child, .key = hashed_key(name) });
+        }
+
+        void add_filter(tag_path::op_code code)
+        {
+            auto begin = static_cast<uint32_t>(path.filters.size());
+            read_compound();
+
+            path.ops.push_back({ .code = code, .filter_begin = begin, .filter_end = static_cast<uint32_t>(path.filters.size()) });
+        }
+
+        void add_elements()
+        {
+            expect('[');
+
+            if (peek() == ']')
+                path.ops.push_back({ .code = tag_path::op_code::each });
+            else if (peek() == '{')
+            {
+                path.ops.push_back({ .code = tag_path::op_code::each });
+                add_filter(tag_path::op_code::filter);
+            }
+            else
+            {
+                int32_t idx;
+                auto [end, error] = std::from_chars(text.data() + pos, text.data() + text.size(), idx);
+                if (error != std::errc()) fail("expected an index");
+
+                pos = end - text.data();
+                path.ops.push_back({ .code = tag_path::op_code::index, .index = idx });
+            }
+
+            expect(']');
+        }
+
+        // An SNBT compound, with its tags added to the filters in order.
+        void read_compound()
+        {
+            expect('{');
+            skip_space();
+
+            if (peek() == '}')
+            {
+                pos++;
+                return;
+            }
+
+            while (true)
+            {
+                skip_space();
+
+                std::string_view key;
+
+                if (peek() == snbt::syntax::string_std_quote || peek() == snbt::syntax::string_alt_quote)
+                    key = read_quoted();
+                else
+                {
+                    key = read_unquoted([](char c) { return snbt::syntax::string_unquoted_chars.find(c) != std::string_view::npos; });
+                    if (key.empty()) fail("expected a name");
+                    key = store(key);
+                }
+
+                skip_space();
+                expect(':');
+                skip_space();
+
+                read_value(key);
+
+                skip_space();
+                if (peek() == ',')
+                {
+                    pos++;
+                    continue;
+                }
+
+                expect('}');
+                return;
+            }
+        }
+
+        void read_value(std::string_view key)
+        {
+            auto idx = path.filters.size();
+            path.filters.push_back({ .key = hashed_key(key), .type = tag_end });
+
+            if (peek() == '{')
+            {
+                path.filters[idx].type = tag_compound;
+                read_compound();
+                path.filters[idx].end = static_cast<uint32_t>(path.filters.size());
+                return;
+            }
+
+            path.filters[idx].end = static_cast<uint32_t>(idx + 1);
+
+            if (peek() == '[') fail("lists and arrays can't be filtered on");
+
+            if (peek() == snbt::syntax::string_std_quote || peek() == snbt::syntax::string_alt_quote)
+            {
+                path.filters[idx].type   = tag_string;
+                path.filters[idx].string = read_quoted();
+                return;
+            }
+
+            auto token = read_unquoted([](char c) { return snbt::syntax::string_unquoted_chars.find(c) != std::string_view::npos; });
+            if (token.empty()) fail("expected a value");
+
+            read_scalar(path.filters[idx], token);
+        }
+
+        // Reads numbers the same way snbt_parser does, and anything that isn't one is an unquoted string.
+        void read_scalar(tag_path::filter &entry, std::string_view token)
+        {
+            snbt::scalar value{ };
+
+            if (!snbt::read_scalar(token, value))
+            {
+                entry.type   = tag_string;
+                entry.string = store(token);
+                return;
+            }
+
+            auto as = [&value]<class V>() {
+                V result;
+                std::memcpy(&result, &value.value, sizeof(V));
+                return result;
+            };
+
+            entry.type = value.type;
+
+            switch (value.type)
+            {
+                // @formatter:off
+                case tag_byte:  entry.integer = as.operator()<int8_t>(); break;
+                case tag_short: entry.integer = as.operator()<int16_t>(); break;
+                case tag_int:   entry.integer = as.operator()<int32_t>(); break;
+                case tag_long:  entry.integer = as.operator()<int64_t>(); break;
+                case tag_float: entry.floating = as.operator()<float>(); break;
+                default:        entry.floating = as.operator()<double>(); break;
+                // @formatter:on
+            }
+        }
+    };
+
+    tag_path::tag_path(std::string_view text_in)
+            : text_v(text_in),
+              names(std::make_unique<char[]>(text_in.size()))
+    { tag_path_compiler(*this, text_in).compile(); }
+
+    bool tag_path::matches(compound &tag, uint32_t filter_begin, uint32_t filter_end) const
+    {
+        tag.materialize();
+
+        for (auto idx = filter_begin; idx < filter_end; idx = filters[idx].end)
+        {
+            const auto &entry = filters[idx];
+
+            auto itr = tag.tags.find(entry.key);
+            if (itr == tag.tags.end()) return false;
+
+            bool same = std::visit([&](auto *found) {
+                using found_t = std::remove_pointer_t<decltype(found)>;
+
+                if constexpr (std::is_same_v<found_t, compound>)
+                    return entry.type == tag_compound && matches(*found, idx + 1, entry.end);
+                else if constexpr (std::is_same_v<found_t, list>)
+                    return false;
+                else
+                {
+                    if (found->type() != entry.type) return false;
+
+                    // @formatter:off
+                    switch (entry.type)
+                    {
+                        case tag_byte:   return found->value.tag_byte == entry.integer;
+                        case tag_short:  return found->value.tag_short == entry.integer;
+                        case tag_int:    return found->value.tag_int == entry.integer;
+                        case tag_long:   return found->value.tag_long == entry.integer;
+                        case tag_float:  return found->value.tag_float == static_cast<float>(entry.floating);
+                        case tag_double: return found->value.tag_double == entry.floating;
+                        case tag_string: return found->template get<tag_string>() == entry.string;
+                        default:         return false;
+                    }
+                    // @formatter:on
+                }
+            }, itr->second);
+
+            if (!same) return false;
+        }
+
+        return true;
+    }
+
+    bool tag_path::matches_raw(char *itr, const char *const itr_end, uint16_t depth, uint32_t filter_begin, uint32_t filter_end) const
+    {
+        size_t wanted = 0;
+        for (auto idx = filter_begin; idx < filter_end; idx = filters[idx].end) wanted++;
+
+        for (size_t found = 0; found < wanted;)
+        {
+            impl::check_entry_bounds(itr, itr_end);
+
+            auto tag_type = static_cast<tag_type_enum>(*itr++);
+            if (static_cast<uint8_t>(tag_type) >= tag_properties.size()) [[unlikely]] throw std::runtime_error("Invalid NBT Tag Type.");
+            if (tag_type == tag_end) return false;
+
+            auto name_len = impl::read_var<uint16_t>(itr);
+            impl::check_name_bounds(itr, itr_end, name_len);
+
+            std::string_view tag_name{ itr, name_len };
+            itr += name_len;
+
+            auto idx = filter_begin;
+            while (idx < filter_end && filters[idx].key.view() != tag_name) idx = filters[idx].end;
+
+            if (idx == filter_end)
+            {
+                itr = skip_raw(tag_type, itr, itr_end, depth + 1);
+                continue;
+            }
+
+            const auto &entry = filters[idx];
+            if (entry.type != tag_type) return false;
+
+            if (tag_type == tag_compound)
+            {
+                if (!matches_raw(itr, itr_end, depth + 1, idx + 1, entry.end)) return false;
+                itr = skip_raw(tag_type, itr, itr_end, depth + 1);
+            }
+            else
+            {
+                auto payload_itr   = itr;
+                auto payload_bytes = impl::read_payload_extent(payload_itr, itr_end, tag_type);
+
+                tag_path::raw_match value{ .type = tag_type, .payload = payload_itr, .payload_len = static_cast<int32_t>(payload_bytes) };
+
+                // @formatter:off
+                bool same;
+                switch (tag_type)
+                {
+                    case tag_byte:   same = value.get<tag_byte>() == entry.integer; break;
+                    case tag_short:  same = value.get<tag_short>() == entry.integer; break;
+                    case tag_int:    same = value.get<tag_int>() == entry.integer; break;
+                    case tag_long:   same = value.get<tag_long>() == entry.integer; break;
+                    case tag_float:  same = value.get<tag_float>() == static_cast<float>(entry.floating); break;
+                    case tag_double: same = value.get<tag_double>() == entry.floating; break;
+                    case tag_string: same = value.get_string() == entry.string; break;
+                    default:         same = false;
+                }
+                // @formatter:on
+
+                if (!same) return false;
+                itr = payload_itr + payload_bytes;
+            }
+
+            found++;
+        }
+
+        return true;
+    }
+
+    char *tag_path::skip_raw(tag_type_enum type, char *itr, const char *const itr_end, uint16_t depth)
+    {
+        if (type == tag_compound) return impl::skip_container(itr, itr_end, tag_compound, tag_end, depth);
+
+        if (type == tag_list)
+        {
+            if (static_cast<size_t>(itr_end - itr) < sizeof(tag_type_enum)) [[unlikely]] throw std::runtime_error("Attempt to read past buffer while parsing binary NBT data.");
+
+            auto elem_type = static_cast<tag_type_enum>(*itr++);
+            if (static_cast<uint8_t>(elem_type) >= tag_properties.size()) [[unlikely]] throw std::runtime_error("Invalid NBT Tag Type.");
+
+            return impl::skip_container(itr, itr_end, tag_list, elem_type, depth);
+        }
+
+        auto payload_bytes = impl::read_payload_extent(itr, itr_end, type);
+        return itr + payload_bytes;
+    }
+}
@@ -0,0 +1,402 @@
+#ifndef MELON_NBT_TAG_PATH_H
+#define MELON_NBT_TAG_PATH_H
+
+#include <bit>
+#include <memory>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+#include "compound.h"
+#include "list.h"
+#include "hashed_key.h"
+
+namespace melon::nbt
+{
+    // A path to tags in a tree, written the way the vanilla /data command takes them:
+    //
+    //   Data.DragonFight.Gateways[2]          a tag by name, then an element of a list or array by index, counting from the end if negative
+    //   sections[{Y:3b}].block_states.data    every compound element of a list holding the tags given, with the same types and values
+    //   Inventory[].id                        every element of a list or array
+    //   Player{OnGround:1b}.Pos               a compound, only if it holds the tags given. A path may also start with one, to test the root.
+    //   "block states".'a.b'                  names with spaces, dots, brackets, or braces are quoted with " or ', and a \ escapes a quote
+    //
+    // A path is compiled once into a sequence of steps, with every name hashed up front, and can then be evaluated against any number of trees
+    // or binary buffers. Filters are SNBT compounds of numbers, strings, and compounds. Lists and arrays can't be filtered on.
+    class tag_path
+    {
+    public:
+        // A tag a path led to in a binary buffer. payload points at it as the buffer lays it out, big endian and past any length prefix: the
+        // first tag of a compound, the element type of a list, or the first element of a string or array. payload_len is the element count of a
+        // list, string or array, and 0 for anything else.
+        struct raw_match
+        {
+            tag_type_enum type;
+            const char    *payload;
+            int32_t       payload_len;
+
+            template<tag_type_enum tag_type>
+            requires is_nbt_primitive<tag_type>
+            [[nodiscard]] tag_prim_t<tag_type> get() const
+            {
+                using value_t = tag_prim_t<tag_type>;
+                using bits_t = std::conditional_t<sizeof(value_t) == 1, uint8_t, std::conditional_t<sizeof(value_t) == 2, uint16_t, std::conditional_t<sizeof(value_t) == 4, uint32_t, uint64_t>>>;
+
+                auto itr = const_cast<char *>(payload);
+                return std::bit_cast<value_t>(impl::read_var<bits_t>(itr));
+            }
+
+            [[nodiscard]] std::string_view get_string() const
+            { return { payload, static_cast<size_t>(payload_len) }; }
+        };
+
+        explicit tag_path(std::string_view text_in);
+
+        tag_path(const tag_path &) = delete;
+        tag_path &operator=(const tag_path &) = delete;
+
+        tag_path(tag_path &&) noexcept = default;
+        tag_path &operator=(tag_path &&) noexcept = default;
+
+        // Calls on_match(tag_variant_t) for every tag the path leads to, in the order they're found. Elements of lists and arrays are references
+        // into them, like list::at() gives out. If on_match returns a bool, returning false stops the walk.
+        template<class F>
+        void visit(compound &root, F &&on_match) const
+        { static_cast<void>(walk<true>(0, root, on_match)); }
+
+        // Same as above, for reading only, so on_match is called with a const_tag_variant_t. Handing those out doesn't count as a change to the
+        // containers holding them.
+        template<class F>
+        void visit(const compound &root, F &&on_match) const
+        {
+            auto read_only = [&on_match](const tag_variant_t &tag) { return deliver(on_match, as_const_variant(tag)); };
+            static_cast<void>(walk<false>(0, const_cast<compound &>(root), read_only));
+        }
+
+        // Walks a binary NBT buffer instead of a tree, calling on_match(raw_match) for every tag the path leads to. Only the parts of the buffer
+        // the path leads through are looked at closely, and everything else is skipped over. What is walked is checked the same way a parse
+        // checks it, so a malformed buffer throws, possibly after some matches were made. As with parsing, raw_size includes the 8 bytes of
+        // padding.
+        template<class F>
+        void visit(const char *raw, size_t raw_size, F &&on_match) const
+        {
+            if (raw_size < 5) [[unlikely]] throw std::runtime_error("NBT Compound Tag Too Small.");
+
+            auto itr     = const_cast<char *>(raw);
+            auto itr_end = raw + raw_size;
+            if (static_cast<tag_type_enum>(*itr++) != tag_compound) [[unlikely]] throw std::runtime_error("NBT tag type not compound.");
+
+            auto name_len = impl::read_var<uint16_t>(itr);
+
+            if ((itr + name_len + padding_size) >= itr_end)
+                [[unlikely]] throw std::runtime_error("Attempt to read past buffer while parsing binary NBT data.");
+
+            static_cast<void>(walk_raw(0, tag_compound, itr + name_len, itr_end, 1, on_match));
+        }
+
+        [[nodiscard]] std::optional<tag_variant_t> first(compound &root) const
+        {
+            std::optional<tag_variant_t> found;
+            visit(root, [&found](tag_variant_t tag) { found = tag; return false; });
+            return found;
+        }
+
+        [[nodiscard]] std::optional<const_tag_variant_t> first(const compound &root) const
+        {
+            std::optional<const_tag_variant_t> found;
+            visit(root, [&found](const_tag_variant_t tag) { found = tag; return false; });
+            return found;
+        }
+
+        [[nodiscard]] size_t count(compound &root) const
+        {
+            size_t matches = 0;
+            visit(std::as_const(root), [&matches](const const_tag_variant_t &) { matches++; });
+            return matches;
+        }
+
+        [[nodiscard]] std::string_view text() const noexcept
+        { return text_v; }
+
+    private:
+        enum class op_code : uint8_t
+        {
+            child,  // The tag named by key.
+            filter, // The compound itself, if it holds filters [filter_begin, filter_end).
+            index,  // Element index of a list or array.
+            each    // Every element of a list or array.
+        };
+
+        struct op
+        {
+            op_code    code;
+            hashed_key key{ std::string_view() };
+            int32_t    index        = 0;
+            uint32_t   filter_begin = 0;
+            uint32_t   filter_end   = 0;
+        };
+
+        // One tag of a filter. Filters are kept in one array in the order they're written, so a compound's own tags follow it up to its end.
+        struct filter
+        {
+            hashed_key       key;
+            tag_type_enum    type;
+            uint32_t         end      = 0;
+            int64_t          integer  = 0;
+            double           floating = 0;
+            std::string_view string{ };
+        };
+
+        std::string             text_v;
+        std::unique_ptr<char[]> names;   // Every name and filter string, unescaped. Keys and filters point into it.
+        std::vector<op>         ops;
+        std::vector<filter>     filters;
+
+        friend class tag_path_compiler;
+
+        [[nodiscard]] bool matches(compound &tag, uint32_t filter_begin, uint32_t filter_end) const;
+        [[nodiscard]] bool matches_raw(char *itr, const char *itr_end, uint16_t depth, uint32_t filter_begin, uint32_t filter_end) const;
+
+        static char *skip_raw(tag_type_enum type, char *itr, const char *itr_end, uint16_t depth);
+
+        // Index ops select one element, if it's in range, and each ops all of them.
+        [[nodiscard]] static std::pair<int32_t, int32_t> element_range(const op &step, int32_t count) noexcept
+        {
+            if (step.code == op_code::each) return { 0, count };
+
+            auto idx = step.index < 0 ? step.index + count : step.index;
+            if (idx < 0 || idx >= count) return { 0, 0 };
+
+            return { idx, idx + 1 };
+        }
+
+        template<class F>
+        static bool deliver(F &on_match, auto &&tag)
+        {
+            if constexpr (std::is_same_v<std::invoke_result_t<F &, decltype(tag)>, bool>)
+                return on_match(std::forward<decltype(tag)>(tag));
+            else
+            {
+                on_match(std::forward<decltype(tag)>(tag));
+                return true;
+            }
+        }
+
+        // The walks return false once on_match has asked to stop. If marks is set, a container is marked as changed before any primitive in it
+        // is walked into.
+        template<bool marks, class F>
+        bool walk(size_t pc, compound &tag, F &on_match) const
+        {
+            if (pc == ops.size()) return deliver(on_match, tag_variant_t{ std::reference_wrapper(tag) });
+
+            const auto &step = ops[pc];
+
+            if (step.code == op_code::filter)
+                return !matches(tag, step.filter_begin, step.filter_end) || walk<marks>(pc + 1, tag, on_match);
+
+            if (step.code != op_code::child) return true;
+
+            tag.materialize();
+            auto itr = tag.tags.find(step.key);
+            if (itr == tag.tags.end()) return true;
+
+            return std::visit([&](auto *child) {
+                if constexpr (marks && std::is_same_v<decltype(child), primitive *>) tag.mark_dirty();
+                return walk<marks>(pc + 1, *child, on_match);
+            }, itr->second);
+        }
+
+        template<bool marks, class F>
+        bool walk(size_t pc, list &tag, F &on_match) const
+        {
+            if (pc == ops.size()) return deliver(on_match, tag_variant_t{ std::reference_wrapper(tag) });
+
+            const auto &step = ops[pc];
+            if (step.code != op_code::index && step.code != op_code::each) return true;
+
+            tag.materialize();
+            auto [first, last] = element_range(step, static_cast<int32_t>(tag.size()));
+
+            // Elements that aren't containers are either handed out, or, if they're arrays, indexed into the same way a compound's are.
+            auto into_arrays = !tag.holds_containers() && !tag.is_packed();
+
+            if (marks && !tag.holds_containers() && (pc + 1 == ops.size() || into_arrays) && first < last) tag.mark_dirty();
+
+            for (auto idx = first; idx < last; idx++)
+            {
+                bool more;
+
+                if (tag.type() == tag_compound)
+                    more = walk<marks>(pc + 1, *static_cast<compound *>(tag.tags[idx]), on_match);
+                else if (tag.type() == tag_list)
+                    more = walk<marks>(pc + 1, *static_cast<list *>(tag.tags[idx]), on_match);
+                else if (pc + 1 == ops.size())
+                    more = deliver(on_match, tag.element(idx));
+                else
+                    more = !into_arrays || walk<marks>(pc + 1, *static_cast<primitive *>(tag.tags[idx]), on_match);
+
+                if (!more) return false;
+            }
+
+            return true;
+        }
+
+        template<bool, class F>
+        bool walk(size_t pc, primitive &tag, F &on_match) const
+        {
+            if (pc == ops.size()) return deliver(on_match, tag.get_generic());
+
+            const auto &step = ops[pc];
+            if ((step.code != op_code::index && step.code != op_code::each) || pc + 1 != ops.size()) return true;
+
+            auto each_element = [&](auto values) {
+                auto [first, last] = element_range(step, static_cast<int32_t>(values.size()));
+
+                for (auto idx = first; idx < last; idx++)
+                    if (!deliver(on_match, tag_variant_t{ std::reference_wrapper(values[idx]) })) return false;
+
+                return true;
+            };
+
+            // @formatter:off
+            switch (tag.type())
+            {
+                case tag_byte_array: return each_element(tag.get<tag_byte_array>());
+                case tag_int_array:  return each_element(tag.get<tag_int_array>());
+                case tag_long_array: return each_element(tag.get<tag_long_array>());
+                default:             return true;
+            }
+            // @formatter:on
+        }
+
+        // itr points at the payload of a tag of the given type, or at the element type of a list. Returns a pointer just past the payload, or
+        // nullptr once on_match has asked to stop.
+        template<class F>
+        char *walk_raw(size_t pc, tag_type_enum type, char *itr, const char *const itr_end, uint16_t depth, F &on_match) const
+        {
+            if (depth > 512) [[unlikely]] throw std::runtime_error("NBT Depth exceeds 512.");
+
+            if (pc == ops.size())
+            {
+                raw_match match{ .type = type, .payload = itr, .payload_len = 0 };
+
+                if (type == tag_list)
+                {
+                    auto count_itr = itr + 1;
+                    if (static_cast<size_t>(itr_end - count_itr) < sizeof(int32_t)) [[unlikely]] throw std::runtime_error("Attempt to read past buffer while parsing binary NBT data.");
+                    match.payload_len = impl::read_var<int32_t>(count_itr);
+                }
+                else if (tag_properties[type].category & (cat_string | cat_array))
+                {
+                    auto payload_itr   = itr;
+                    auto payload_bytes = impl::read_payload_extent(payload_itr, itr_end, type);
+
+                    match.payload     = payload_itr;
+                    match.payload_len = static_cast<int32_t>(payload_bytes / tag_properties[type].size);
+                }
+
+                if (!deliver(on_match, match)) return nullptr;
+                return skip_raw(type, itr, itr_end, depth);
+            }
+
+            const auto &step = ops[pc];
+
+            if (type == tag_compound)
+            {
+                if (step.code == op_code::filter)
+                {
+                    if (matches_raw(itr, itr_end, depth, step.filter_begin, step.filter_end)) return walk_raw(pc + 1, type, itr, itr_end, depth, on_match);
+                    return skip_raw(type, itr, itr_end, depth);
+                }
+
+                if (step.code != op_code::child) return skip_raw(type, itr, itr_end, depth);
+
+                while (true)
+                {
+                    impl::check_entry_bounds(itr, itr_end);
+
+                    auto tag_type = static_cast<tag_type_enum>(*itr++);
+                    if (static_cast<uint8_t>(tag_type) >= tag_properties.size()) [[unlikely]] throw std::runtime_error("Invalid NBT Tag Type.");
+                    if (tag_type == tag_end) return itr;
+
+                    auto name_len = impl::read_var<uint16_t>(itr);
+                    impl::check_name_bounds(itr, itr_end, name_len);
+
+                    std::string_view tag_name{ itr, name_len };
+                    itr += name_len;
+
+                    if (tag_name == step.key.view())
+                        itr = walk_raw(pc + 1, tag_type, itr, itr_end, depth + 1, on_match);
+                    else
+                        itr = skip_raw(tag_type, itr, itr_end, depth + 1);
+
+                    if (itr == nullptr) return nullptr;
+                }
+            }
+
+            if (step.code != op_code::index && step.code != op_code::each) return skip_raw(type, itr, itr_end, depth);
+
+            if (type == tag_list)
+            {
+                if (static_cast<size_t>(itr_end - itr) < sizeof(tag_type_enum) + sizeof(int32_t)) [[unlikely]] throw std::runtime_error("Attempt to read past buffer while parsing binary NBT data.");
+
+                auto elem_type = static_cast<tag_type_enum>(*itr++);
+                if (static_cast<uint8_t>(elem_type) >= tag_properties.size()) [[unlikely]] throw std::runtime_error("Invalid NBT Tag Type.");
+
+                auto count = impl::read_var<int32_t>(itr);
+                if (count < 0) [[unlikely]] throw std::runtime_error("Found list with negative length while parsing binary NBT data.");
+                if (elem_type == tag_end && count > 0) [[unlikely]] throw std::runtime_error("Found populated list with no type.");
+
+                auto [first, last] = element_range(step, count);
+
+                // Fixed size elements are found by offset rather than walked over.
+                if (tag_properties[elem_type].category == cat_primitive)
+                {
+                    auto elem_size     = tag_properties[elem_type].size;
+                    auto payload_bytes = static_cast<size_t>(count) * elem_size;
+
+                    impl::check_payload_bounds(itr, itr_end, payload_bytes);
+
+                    if (pc + 1 == ops.size())
+                        for (auto idx = first; idx < last; idx++)
+                            if (!deliver(on_match, raw_match{ .type = elem_type, .payload = itr + idx * elem_size, .payload_len = 0 })) return nullptr;
+
+                    return itr + payload_bytes;
+                }
+
+                for (int32_t idx = 0; idx < count; idx++)
+                {
+                    impl::check_element_bounds(itr, itr_end, elem_type);
+
+                    if (idx >= first && idx < last)
+                        itr = walk_raw(pc + 1, elem_type, itr, itr_end, depth + 1, on_match);
+                    else
+                        itr = skip_raw(elem_type, itr, itr_end, depth + 1);
+
+                    if (itr == nullptr) return nullptr;
+                }
+
+                return itr;
+            }
+
+            if (type != tag_byte_array && type != tag_int_array && type != tag_long_array) return skip_raw(type, itr, itr_end, depth);
+
+            auto payload_bytes = impl::read_payload_extent(itr, itr_end, type);
+            auto elem_size     = tag_properties[type].size;
+            auto elem_type     = type == tag_byte_array ? tag_byte : type == tag_int_array ? tag_int : tag_long;
+
+            if (pc + 1 == ops.size())
+            {
+                auto [first, last] = element_range(step, static_cast<int32_t>(payload_bytes / elem_size));
+
+                for (auto idx = first; idx < last; idx++)
+                    if (!deliver(on_match, raw_match{ .type = elem_type, .payload = itr + idx * elem_size, .payload_len = 0 })) return nullptr;
+            }
+
+            return itr + payload_bytes;
+        }
+    };
+}
+
+#endif //MELON_NBT_TAG_PATH_H
@@ -0,0 +1,109 @@
+#include "compound.h"
+#include "list.h"
+#include "tree_builder.h"
+
+namespace melon::nbt
+{
+    compound *tree_builder::start(std::string_view name)
+    {
+        destroy();
+
+        root = mem::pmr::make_obj_using_pmr<compound>(pmr_rsrc, name);
+        stack[stack_size++] = { root, tag_compound, tag_end, 0 };
+
+        return root;
+    }
+
+    // Same as the containers parser::read() opens, except that the name always has to be copied, as the input doesn't stay around.
+    template<class T, class P>
+    T *tree_builder::open(P *parent, std::string_view name, tag_type_enum list_type, int32_t remaining)
+    {
+        if (parent->depth >= 512) [[unlikely]] throw std::runtime_error("NBT Depth exceeds 512.");
+
+        auto tag_key = name.empty() ? tag_name() : tag_name::copy_of(name, pmr_rsrc);
+        T    *container;
+
+        try
+        {
+            impl::parse_node_args args{ .parent = parent, .top = root, .pmr_rsrc = pmr_rsrc, .name = tag_key, .depth = static_cast<uint16_t>(parent->depth + 1),
+                                        .max_bytes = parent->max_bytes, .list_type = list_type };
+
+            if constexpr (std::is_same_v<P, list>)
+                container = parent->template make_element<T>(args);
+            else
+                container = mem::pmr::make_obj_using_pmr<T>(pmr_rsrc, args);
+        }
+        catch (...)
+        {
+            tag_key.release(pmr_rsrc);
+            throw;
+        }
+
+        try
+        {
+            if constexpr (std::is_same_v<P, compound>)
+            {
+                const auto &[_, success] = parent->tags.insert(std::pair{ container->name.view(), container });
+                if (!success) throw std::runtime_error("Unable to insert NBT tag to compound (possible duplicate).");
+            }
+            else
+                parent->tags.push_back(container);
+        }
+        catch (...)
+        {
+            std::visit([](auto &parent_ptr) { parent_ptr = nullptr; }, container->parent);
+
+            if constexpr (std::is_same_v<P, list>)
+                parent->destroy_element(container);
+            else
+                mem::pmr::destroy_obj_using_pmr(pmr_rsrc, container);
+
+            throw;
+        }
+
+        if constexpr (std::is_same_v<T, compound>)
+            stack[stack_size++] = { container, tag_compound, tag_end, remaining };
+        else
+            stack[stack_size++] = { container, tag_list, list_type, remaining };
+
+        return container;
+    }
+
+    template compound *tree_builder::open<compound, compound>(compound *, std::string_view, tag_type_enum, int32_t);
+    template compound *tree_builder::open<compound, list>(list *, std::string_view, tag_type_enum, int32_t);
+    template list *tree_builder::open<list, compound>(compound *, std::string_view, tag_type_enum, int32_t);
+    template list *tree_builder::open<list, list>(list *, std::string_view, tag_type_enum, int32_t);
+
+    bool tree_builder::close() noexcept
+    {
+        auto bytes_of = [](const frame &entry) -> size_t & {
+            if (entry.type == tag_compound)
+                return static_cast<compound *>(entry.container)->byte_count_v;
+            else
+                return static_cast<list *>(entry.container)->byte_count_v;
+        };
+
+        auto &closed = stack[--stack_size];
+        if (stack_size > 0) bytes_of(stack[stack_size - 1]) += bytes_of(closed);
+
+        return stack_size == 0;
+    }
+
+    mem::pmr::unique_ptr<compound> tree_builder::release() noexcept
+    {
+        stack_size = 0;
+        return mem::pmr::unique_ptr<compound>(std::exchange(root, nullptr), mem::pmr::default_deleter<compound>(pmr_rsrc));
+    }
+
+    void tree_builder::destroy() noexcept
+    {
+        if (root == nullptr) return;
+
+        // Containers still open haven't been counted in their parents yet.
+        while (stack_size > 1)
+            close();
+
+        mem::pmr::destroy_obj_using_pmr(pmr_rsrc, std::exchange(root, nullptr));
+        stack_size = 0;
+    }
+}
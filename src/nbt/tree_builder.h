@@ -0,0 +1,71 @@
+#ifndef MELON_NBT_TREE_BUILDER_H
+#define MELON_NBT_TREE_BUILDER_H
+
+#include <array>
+#include <memory_resource>
+#include <string_view>
+#include "constants.h"
+#include "mem/pmr.h"
+
+namespace melon::nbt
+{
+    class compound;
+
+    class list;
+
+    // A tree being built top down by a parser that doesn't recurse, with the containers that are still open kept on a stack. stream_parser
+    // and snbt_parser both build theirs with it, so a container is created, named, and added to its parent the same way whichever of them
+    // reads it. Anything still open when it's destroyed is torn down with it.
+    class tree_builder
+    {
+    public:
+        struct frame
+        {
+            void          *container;
+            tag_type_enum type;
+            tag_type_enum list_type;
+            int32_t       remaining; // Elements left to read, for input that gives a list's length up front.
+        };
+
+        explicit tree_builder(std::pmr::memory_resource *pmr_rsrc_in) noexcept
+                : pmr_rsrc(pmr_rsrc_in)
+        { }
+
+        tree_builder(const tree_builder &) = delete;
+        tree_builder &operator=(const tree_builder &) = delete;
+
+        ~tree_builder()
+        { destroy(); }
+
+        // Starts a tree with an empty root compound, which already counts its END tag. Anything built before is destroyed.
+        compound *start(std::string_view name);
+
+        // Creates a compound or list, adds it to parent, and opens it. A list takes its type up front. Throws on a duplicate name, or if it'd
+        // be nested too deep.
+        template<class T, class P>
+        T *open(P *parent, std::string_view name, tag_type_enum list_type, int32_t remaining = 0);
+
+        // Closes the innermost container, adding its bytes to its parent's. Returns true once the root has been closed.
+        bool close() noexcept;
+
+        // Hands over the tree, closed or not.
+        mem::pmr::unique_ptr<compound> release() noexcept;
+
+        void destroy() noexcept;
+
+        [[nodiscard]] frame &top() noexcept
+        { return stack[stack_size - 1]; }
+
+        [[nodiscard]] bool is_open() const noexcept
+        { return stack_size > 0; }
+
+    private:
+        std::pmr::memory_resource *pmr_rsrc;
+        compound                  *root = nullptr;
+
+        std::array<frame, 513> stack;
+        size_t                 stack_size = 0;
+    };
+}
+
+#endif //MELON_NBT_TREE_BUILDER_H
@@ -5,6 +5,7 @@
 #ifndef MELON_NBT_TYPES_H
 #define MELON_NBT_TYPES_H
 
+#include <functional>
 #include <string_view>
 #include <span>
 #include <variant>
@@ -120,6 +121,42 @@ namespace melon::nbt
     using refwrap_variant_types_t = typename refwrap_variant_types<T>::type;
 
     using tag_variant_t = util::transform_tuple_types<refwrap_variant_types_t, std::variant, tag_access_types>::type;
+
+    template<class T>
+    struct add_const_access
+    {
+        using type = T;
+    };
+
+    template<class T>
+    struct add_const_access<std::reference_wrapper<T>>
+    {
+        using type = std::reference_wrapper<const T>;
+    };
+
+    template<class T, size_t extent>
+    struct add_const_access<std::span<T, extent>>
+    {
+        using type = std::span<const T, extent>;
+    };
+
+    template<class T>
+    using const_refwrap_variant_types_t = typename add_const_access<refwrap_variant_types_t<T>>::type;
+
+    // The same as tag_variant_t, with the alternatives in the same order, but for reading only.
+    using const_tag_variant_t = util::transform_tuple_types<const_refwrap_variant_types_t, std::variant, tag_access_types>::type;
+
+    inline const_tag_variant_t as_const_variant(const tag_variant_t &tag)
+    {
+        return std::visit([](const auto &value) -> const_tag_variant_t {
+            using value_t = std::remove_cvref_t<decltype(value)>;
+
+            if constexpr (requires { value.get(); })
+                return std::cref(value.get());
+            else
+                return typename add_const_access<value_t>::type(value);
+        }, tag);
+    }
 }
 
 #endif //MELON_NBT_TYPES_H
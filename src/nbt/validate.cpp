@@ -0,0 +1,64 @@
+#include <algorithm>
+#include "compound.h"
+#include "validate.h"
+
+namespace melon::nbt
+{
+    document_stats validate(const char *raw, size_t raw_size) noexcept
+    {
+        document_stats stats;
+
+        struct
+        {
+            document_stats &stats;
+            uint16_t       level = 0;
+
+            void open(tag_type_enum type, std::string_view name, tag_type_enum, int32_t) noexcept
+            {
+                stats.max_depth = std::max(stats.max_depth, ++level);
+                stats.tag_counts[type]++;
+                stats.name_bytes += name.size();
+            }
+
+            void close(tag_type_enum, int32_t) noexcept
+            { level--; }
+
+            void tag(tag_type_enum type, std::string_view name, const char *, int32_t payload_len) noexcept
+            {
+                stats.tag_counts[type]++;
+                stats.name_bytes += name.size();
+
+                if (type == tag_string)
+                    stats.string_bytes += payload_len;
+                else if (tag_properties[type].category == cat_array)
+                    stats.largest_array = std::max(stats.largest_array, static_cast<size_t>(payload_len));
+            }
+        } counter{ .stats = stats };
+
+        try
+        {
+            if (raw_size < 5) [[unlikely]] throw std::runtime_error("NBT Compound Tag Too Small.");
+
+            // The walk only ever reads through itr.
+            auto itr     = const_cast<char *>(raw);
+            auto itr_end = raw + raw_size;
+            if (static_cast<tag_type_enum>(*itr++) != tag_compound) [[unlikely]] throw std::runtime_error("NBT tag type not compound.");
+
+            auto name_len = impl::read_var<uint16_t>(itr);
+            impl::check_name_bounds(itr, itr_end, name_len);
+
+            std::string_view name{ itr, name_len };
+            itr += name_len;
+
+            stats.bytes = impl::walk_container(itr, itr_end, tag_compound, tag_end, 1, counter, name) - raw;
+            stats.valid = true;
+        }
+        catch (const std::exception &e)
+        {
+            // The numbers only cover what was read before the problem was found, which isn't worth handing back.
+            stats = { .valid = false, .error = e.what() };
+        }
+
+        return stats;
+    }
+}
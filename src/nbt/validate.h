@@ -0,0 +1,29 @@
+#ifndef MELON_NBT_VALIDATE_H
+#define MELON_NBT_VALIDATE_H
+
+#include <array>
+#include <string>
+#include "constants.h"
+
+namespace melon::nbt
+{
+    struct document_stats
+    {
+        bool        valid = false;
+        std::string error;                        // Why the buffer was rejected. Left empty, and unallocated, when it's valid.
+
+        size_t                         bytes         = 0; // Serialized size, not counting padding.
+        uint16_t                       max_depth     = 0; // The root compound is at depth 1.
+        std::array<size_t, tag_count> tag_counts{ };      // Including the root compound and list elements. tag_end is always 0.
+        size_t                         largest_array = 0; // In elements, across all three array types.
+        size_t                         string_bytes  = 0; // String payloads, not counting names or length prefixes.
+        size_t                         name_bytes    = 0;
+    };
+
+    // Checks a binary NBT buffer the same way compound's parsing constructors do, without building anything or allocating unless it's
+    // rejected, and gathers some numbers about it along the way. As with parsing, raw_size includes the 8 bytes of padding. Duplicate names
+    // in a compound can't be found without keeping track of them, so those are the one thing that passes here and fails to parse.
+    document_stats validate(const char *raw, size_t raw_size) noexcept;
+}
+
+#endif //MELON_NBT_VALIDATE_H
@@ -76,4 +76,24 @@ namespace melon::util
 
         return { std::move(out), out_size };
     }
+
+    size_t gzip_deflate(std::span<const char> in, std::span<char> out, libdeflate_compressor *c, int level)
+    {
+        auto own_compressor = c == nullptr;
+        if (own_compressor)
+            c = libdeflate_alloc_compressor(level);
+
+        if (c == nullptr)
+            [[unlikely]]
+                    throw std::runtime_error("Failure to create compressor object while trying to compress to gzip buffer.");
+
+        auto out_size = libdeflate_gzip_compress(c, static_cast<const void *>(in.data()), in.size(), static_cast<void *>(out.data()), out.size());
+        if (own_compressor) libdeflate_free_compressor(c);
+
+        if (out_size == 0)
+            [[unlikely]]
+                    throw std::runtime_error("Output buffer too small while trying to compress to gzip buffer.");
+
+        return out_size;
+    }
 }
\ No newline at end of file
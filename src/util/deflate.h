@@ -5,11 +5,17 @@
 #ifndef LODE_UTIL_DEFLATE_H
 #define LODE_UTIL_DEFLATE_H
 
+#include <memory>
+#include <span>
 #include "libdeflate.h"
 
 namespace melon::util {
     std::pair<std::unique_ptr<char[]>, size_t> gzip_inflate(std::unique_ptr<char[]> &&buf_ptr, size_t buf_size, libdeflate_decompressor *d = nullptr);
     std::pair<std::unique_ptr<char[]>, size_t> gzip_deflate(std::unique_ptr<char[]> &&buf_ptr, size_t buf_size, libdeflate_compressor *c = nullptr, int level = 6);
+
+    // Compresses in into a buffer the caller keeps, so one can be reused across calls. Returns how much of out was used. Throws if it doesn't
+    // fit, which can't happen if out is at least libdeflate_gzip_compress_bound() bytes.
+    size_t gzip_deflate(std::span<const char> in, std::span<char> out, libdeflate_compressor *c = nullptr, int level = 6);
 }
 
 #endif //LODE_UTIL_DEFLATE_H
@@ -0,0 +1,529 @@
+#include <bit>
+#include <cstring>
+#include <algorithm>
+#include <stdexcept>
+#include "libdeflate.h"
+#include "inflate_stream.h"
+
+// For details on the formats go to: https://www.rfc-editor.org/rfc/rfc1950 (zlib), https://www.rfc-editor.org/rfc/rfc1951 (DEFLATE), and
+// https://www.rfc-editor.org/rfc/rfc1952 (gzip)
+
+namespace melon::util
+{
+    namespace
+    {
+        constexpr size_t history_size = 32768;
+        constexpr size_t window_size  = history_size * 2;
+
+        // @formatter:off
+        constexpr uint16_t length_base[29]  = { 3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31, 35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258 };
+        constexpr uint8_t  length_extra[29] = { 0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2, 3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0 };
+        constexpr uint16_t dist_base[30]    = { 1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193, 257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145,
+                                                8193, 12289, 16385, 24577 };
+        constexpr uint8_t  dist_extra[30]   = { 0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6, 7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13 };
+        constexpr uint8_t  code_length_order[19] = { 16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15 };
+        // @formatter:on
+    }
+
+    inflate_stream::inflate_stream(format format_in)
+            : format_v(format_in),
+              window(std::make_unique<uint8_t[]>(window_size))
+    { }
+
+    void inflate_stream::huffman::build(const uint8_t *lengths, size_t symbol_count)
+    {
+        count.fill(0);
+        for (size_t sym = 0; sym < symbol_count; sym++)
+            count[lengths[sym]]++;
+
+        count[0] = 0;
+
+        // Incomplete codes are allowed, as an unused code just fails to decode, but over-subscribed codes can't be decoded at all.
+        int left = 1;
+        for (size_t len = 1; len < count.size(); len++)
+        {
+            left = (left << 1) - count[len];
+            if (left < 0) [[unlikely]] throw std::runtime_error("Over-subscribed Huffman code found while inflating stream.");
+        }
+
+        std::array<uint16_t, 16> offsets{ };
+        std::array<uint16_t, 16> next_code{ };
+
+        for (size_t len = 1; len < count.size() - 1; len++)
+            offsets[len + 1] = offsets[len] + count[len];
+
+        for (size_t len = 1, code = 0; len < count.size(); len++)
+        {
+            code            = (code + count[len - 1]) << 1;
+            next_code[len] = code;
+        }
+
+        fast.fill(0);
+
+        for (uint16_t sym = 0; sym < symbol_count; sym++)
+        {
+            auto len = lengths[sym];
+            if (len == 0) continue;
+
+            symbols[offsets[len]++] = sym;
+
+            auto code = next_code[len]++;
+            if (len > fast_bits) continue;
+
+            // Codes are stored most significant bit first, but read least significant bit first.
+            uint32_t reversed = 0;
+            for (unsigned bit = 0; bit < len; bit++)
+                reversed |= ((code >> bit) & 1) << (len - 1 - bit);
+
+            for (auto idx = reversed; idx < fast.size(); idx += (1u << len))
+                fast[idx] = static_cast<uint16_t>(sym << 4 | len);
+        }
+    }
+
+    const std::pair<inflate_stream::huffman, inflate_stream::huffman> &inflate_stream::fixed_codes()
+    {
+        static const auto codes = [] {
+            std::pair<huffman, huffman> fixed;
+            std::array<uint8_t, 288>    lengths{ };
+
+            std::fill(lengths.begin(), lengths.begin() + 144, 8);
+            std::fill(lengths.begin() + 144, lengths.begin() + 256, 9);
+            std::fill(lengths.begin() + 256, lengths.begin() + 280, 7);
+            std::fill(lengths.begin() + 280, lengths.end(), 8);
+            fixed.first.build(lengths.data(), lengths.size());
+
+            lengths.fill(5);
+            fixed.second.build(lengths.data(), 30);
+
+            return fixed;
+        }();
+
+        return codes;
+    }
+
+    void inflate_stream::feed(const char *data, size_t size, const sink_t &sink)
+    {
+        if (stage_v == stage::done) return;
+
+        // Whole bytes already pulled into bit_buf are given back, so everything before in_pos can be dropped.
+        in_pos -= bit_count / 8;
+        bit_buf &= (uint64_t(1) << (bit_count % 8)) - 1;
+        bit_count %= 8;
+
+        pending.erase(pending.begin(), pending.begin() + static_cast<std::ptrdiff_t>(in_pos));
+        pending.insert(pending.end(), reinterpret_cast<const uint8_t *>(data), reinterpret_cast<const uint8_t *>(data) + size);
+        in_pos = 0;
+
+        bool progressed = true;
+
+        while (progressed)
+        {
+            switch (stage_v)
+            {
+                // @formatter:off
+                case stage::header:       progressed = read_header(); break;
+                case stage::block_header: progressed = read_block_header(); break;
+                case stage::stored:       progressed = copy_stored(sink); break;
+                case stage::compressed:   progressed = inflate_block(sink); break;
+                case stage::trailer:      progressed = read_trailer(sink); break;
+                case stage::done:         progressed = false; break;
+                // @formatter:on
+            }
+        }
+
+        flush(sink);
+    }
+
+    void inflate_stream::finish() const
+    {
+        if (stage_v != stage::done) [[unlikely]] throw std::runtime_error("Compressed stream ended early.");
+    }
+
+    bool inflate_stream::need_bits(unsigned bits)
+    {
+        while (bit_count < bits && in_pos < pending.size())
+        {
+            bit_buf |= static_cast<uint64_t>(pending[in_pos++]) << bit_count;
+            bit_count += 8;
+        }
+
+        return bit_count >= bits;
+    }
+
+    uint32_t inflate_stream::take_bits(unsigned bits)
+    {
+        auto value = static_cast<uint32_t>(bit_buf & ((uint64_t(1) << bits) - 1));
+
+        bit_buf >>= bits;
+        bit_count -= bits;
+
+        return value;
+    }
+
+    bool inflate_stream::read_header()
+    {
+        auto start = position();
+
+        if (!need_bits(16)) return rewind(start);
+
+        if (format_v == format::detect)
+            format_v = (bit_buf & 0xFF) == 0x1F ? format::gzip : format::zlib;
+
+        if (format_v == format::zlib)
+        {
+            auto cmf = take_bits(8);
+            auto flg = take_bits(8);
+
+            if ((cmf & 0x0F) != 8 || ((cmf << 8) | flg) % 31 != 0) [[unlikely]] throw std::runtime_error("Invalid zlib header found while inflating stream.");
+            if (flg & 0x20) [[unlikely]] throw std::runtime_error("zlib streams with a preset dictionary are not supported.");
+
+            checksum = 1;
+        }
+        else
+        {
+            if (take_bits(8) != 0x1F || take_bits(8) != 0x8B) [[unlikely]] throw std::runtime_error("Invalid gzip header found while inflating stream.");
+            if (!need_bits(16)) return rewind(start);
+            if (take_bits(8) != 8) [[unlikely]] throw std::runtime_error("Unsupported gzip compression method found while inflating stream.");
+
+            auto flags = take_bits(8);
+
+            // MTIME, XFL, and OS
+            for (int skip = 0; skip < 6; skip++)
+            {
+                if (!need_bits(8)) return rewind(start);
+                take_bits(8);
+            }
+
+            if (flags & 0x04) // FEXTRA
+            {
+                if (!need_bits(16)) return rewind(start);
+
+                for (auto extra_len = take_bits(16); extra_len > 0; extra_len--)
+                {
+                    if (!need_bits(8)) return rewind(start);
+                    take_bits(8);
+                }
+            }
+
+            // FNAME and FCOMMENT are zero terminated.
+            for (auto flag: { 0x08, 0x10 })
+            {
+                if (!(flags & flag)) continue;
+
+                do
+                {
+                    if (!need_bits(8)) return rewind(start);
+                } while (take_bits(8) != 0);
+            }
+
+            if (flags & 0x02) // FHCRC
+            {
+                if (!need_bits(16)) return rewind(start);
+                take_bits(16);
+            }
+
+            checksum = 0;
+        }
+
+        stage_v = stage::block_header;
+        return true;
+    }
+
+    bool inflate_stream::read_block_header()
+    {
+        auto start = position();
+
+        if (!need_bits(3)) return rewind(start);
+
+        final_block = take_bits(1) != 0;
+
+        switch (take_bits(2))
+        {
+            case 0:
+            {
+                take_bits(bit_count % 8);
+                if (!need_bits(32)) return rewind(start);
+
+                auto len  = take_bits(16);
+                auto nlen = take_bits(16);
+
+                if ((len ^ 0xFFFF) != nlen) [[unlikely]] throw std::runtime_error("Invalid stored block length found while inflating stream.");
+
+                stored_left = len;
+                stage_v     = stage::stored;
+                break;
+            }
+
+            case 1:
+                lit_len_code = &fixed_codes().first;
+                dist_code    = &fixed_codes().second;
+                stage_v      = stage::compressed;
+                break;
+
+            case 2:
+                if (!read_dynamic_codes()) return rewind(start);
+                stage_v = stage::compressed;
+                break;
+
+            default:
+                throw std::runtime_error("Invalid block type found while inflating stream.");
+        }
+
+        return true;
+    }
+
+    bool inflate_stream::read_dynamic_codes()
+    {
+        if (!need_bits(14)) return false;
+
+        auto lit_len_count = take_bits(5) + 257;
+        auto dist_count    = take_bits(5) + 1;
+        auto length_count  = take_bits(4) + 4;
+
+        if (lit_len_count > 286 || dist_count > 30) [[unlikely]] throw std::runtime_error("Invalid dynamic block header found while inflating stream.");
+
+        std::array<uint8_t, 19> length_lengths{ };
+
+        for (uint32_t idx = 0; idx < length_count; idx++)
+        {
+            if (!need_bits(3)) return false;
+            length_lengths[code_length_order[idx]] = take_bits(3);
+        }
+
+        if (!dynamic_codes) dynamic_codes = std::make_unique<std::pair<huffman, huffman>>();
+
+        // The code length code is only needed here, so it's built in the distance code's place.
+        auto &length_code = dynamic_codes->second;
+        length_code.build(length_lengths.data(), length_lengths.size());
+
+        std::array<uint8_t, 286 + 30> lengths{ };
+
+        for (uint32_t idx = 0; idx < lit_len_count + dist_count;)
+        {
+            auto sym = decode(length_code);
+            if (sym < 0) return false;
+
+            if (sym < 16)
+            {
+                lengths[idx++] = sym;
+                continue;
+            }
+
+            uint8_t  repeat_len;
+            uint32_t repeat;
+
+            if (sym == 16)
+            {
+                if (idx == 0) [[unlikely]] throw std::runtime_error("Invalid code length repeat found while inflating stream.");
+                if (!need_bits(2)) return false;
+
+                repeat_len = lengths[idx - 1];
+                repeat     = 3 + take_bits(2);
+            }
+            else if (sym == 17)
+            {
+                if (!need_bits(3)) return false;
+
+                repeat_len = 0;
+                repeat     = 3 + take_bits(3);
+            }
+            else
+            {
+                if (!need_bits(7)) return false;
+
+                repeat_len = 0;
+                repeat     = 11 + take_bits(7);
+            }
+
+            if (idx + repeat > lit_len_count + dist_count) [[unlikely]] throw std::runtime_error("Too many code lengths found while inflating stream.");
+
+            while (repeat-- > 0)
+                lengths[idx++] = repeat_len;
+        }
+
+        if (lengths[256] == 0) [[unlikely]] throw std::runtime_error("Dynamic block without an end code found while inflating stream.");
+
+        dynamic_codes->first.build(lengths.data(), lit_len_count);
+        dynamic_codes->second.build(lengths.data() + lit_len_count, dist_count);
+
+        lit_len_code = &dynamic_codes->first;
+        dist_code    = &dynamic_codes->second;
+
+        return true;
+    }
+
+    int inflate_stream::decode(const huffman &code)
+    {
+        need_bits(huffman::fast_bits);
+
+        auto entry = code.fast[bit_buf & (code.fast.size() - 1)];
+
+        if (entry != 0 && (entry & 0x0F) <= bit_count)
+        {
+            take_bits(entry & 0x0F);
+            return entry >> 4;
+        }
+
+        // Longer codes, or running short of input, fall back to walking the code one bit at a time.
+        need_bits(15);
+
+        int first = 0, index = 0, value = 0;
+
+        for (unsigned len = 1; len < code.count.size(); len++)
+        {
+            if (len > bit_count) return -1;
+
+            value |= static_cast<int>((bit_buf >> (len - 1)) & 1);
+
+            int count = code.count[len];
+            if (value - count < first)
+            {
+                take_bits(len);
+                return code.symbols[index + (value - first)];
+            }
+
+            index += count;
+            first = (first + count) << 1;
+            value <<= 1;
+        }
+
+        throw std::runtime_error("Invalid Huffman code found while inflating stream.");
+    }
+
+    bool inflate_stream::copy_stored(const sink_t &sink)
+    {
+        // The block is byte aligned, so anything left in bit_buf is whole bytes.
+        while (stored_left > 0 && bit_count >= 8)
+        {
+            make_room(1, sink);
+            window[out_pos++] = take_bits(8);
+            stored_left--;
+        }
+
+        while (stored_left > 0 && in_pos < pending.size())
+        {
+            make_room(1, sink);
+
+            auto chunk = std::min({ static_cast<size_t>(stored_left), pending.size() - in_pos, window_size - out_pos });
+            std::memcpy(&window[out_pos], &pending[in_pos], chunk);
+
+            out_pos += chunk;
+            in_pos += chunk;
+            stored_left -= chunk;
+        }
+
+        if (stored_left > 0) return false;
+
+        stage_v = final_block ? stage::trailer : stage::block_header;
+        return true;
+    }
+
+    bool inflate_stream::inflate_block(const sink_t &sink)
+    {
+        while (true)
+        {
+            auto start = position();
+
+            auto sym = decode(*lit_len_code);
+            if (sym < 0) return rewind(start);
+
+            if (sym < 256)
+            {
+                make_room(1, sink);
+                window[out_pos++] = static_cast<uint8_t>(sym);
+                continue;
+            }
+
+            if (sym == 256)
+            {
+                stage_v = final_block ? stage::trailer : stage::block_header;
+                return true;
+            }
+
+            sym -= 257;
+            if (sym >= 29) [[unlikely]] throw std::runtime_error("Invalid length code found while inflating stream.");
+            if (!need_bits(length_extra[sym])) return rewind(start);
+
+            auto length = length_base[sym] + take_bits(length_extra[sym]);
+
+            auto dist_sym = decode(*dist_code);
+            if (dist_sym < 0) return rewind(start);
+            if (dist_sym >= 30) [[unlikely]] throw std::runtime_error("Invalid distance code found while inflating stream.");
+            if (!need_bits(dist_extra[dist_sym])) return rewind(start);
+
+            auto distance = dist_base[dist_sym] + take_bits(dist_extra[dist_sym]);
+
+            make_room(length, sink);
+            if (distance > out_pos) [[unlikely]] throw std::runtime_error("Distance too far back found while inflating stream.");
+
+            // Matches may overlap what they're writing, so this has to go a byte at a time.
+            auto src = &window[out_pos - distance];
+            auto dst = &window[out_pos];
+
+            for (uint32_t idx = 0; idx < length; idx++)
+                dst[idx] = src[idx];
+
+            out_pos += length;
+        }
+    }
+
+    bool inflate_stream::read_trailer(const sink_t &sink)
+    {
+        flush(sink);
+        take_bits(bit_count % 8);
+
+        if (format_v == format::gzip)
+        {
+            auto start = position();
+
+            if (!need_bits(32)) return false;
+            auto crc = take_bits(32);
+
+            if (!need_bits(32)) return rewind(start);
+            auto isize = take_bits(32);
+
+            if (crc != checksum) [[unlikely]] throw std::runtime_error("CRC mismatch found while inflating gzip stream.");
+            if (isize != total_out) [[unlikely]] throw std::runtime_error("Size mismatch found while inflating gzip stream.");
+        }
+        else
+        {
+            if (!need_bits(32)) return false;
+
+            auto adler = std::byteswap(take_bits(32));
+            if (adler != checksum) [[unlikely]] throw std::runtime_error("Adler-32 mismatch found while inflating zlib stream.");
+        }
+
+        stage_v = stage::done;
+        return true;
+    }
+
+    void inflate_stream::make_room(size_t bytes, const sink_t &sink)
+    {
+        if (out_pos + bytes <= window_size) return;
+
+        flush(sink);
+
+        // Keep the last 32KB around for matches to refer back to.
+        std::memmove(&window[0], &window[out_pos - history_size], history_size);
+        out_pos     = history_size;
+        flushed_pos = history_size;
+    }
+
+    void inflate_stream::flush(const sink_t &sink)
+    {
+        if (out_pos == flushed_pos) return;
+
+        auto data = reinterpret_cast<const char *>(&window[flushed_pos]);
+        auto size = out_pos - flushed_pos;
+
+        if (format_v == format::gzip)
+            checksum = libdeflate_crc32(checksum, data, size);
+        else
+            checksum = libdeflate_adler32(checksum, data, size);
+
+        total_out += static_cast<uint32_t>(size);
+        flushed_pos = out_pos;
+
+        sink(data, size);
+    }
+}
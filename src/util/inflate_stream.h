@@ -0,0 +1,130 @@
+#ifndef MELON_UTIL_INFLATE_STREAM_H
+#define MELON_UTIL_INFLATE_STREAM_H
+
+#include <array>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <utility>
+#include <vector>
+
+namespace melon::util
+{
+    // Decompresses a gzip or zlib stream handed to it in pieces of any size, passing the output on as it's produced. Only the 32KB DEFLATE
+    // history (twice over, so it doesn't have to slide on every write) and whatever input was left over at the end of the last piece are
+    // kept, instead of the whole compressed and decompressed streams. If the sink or the stream throws, the inflater can't be used any more.
+    class inflate_stream
+    {
+    public:
+        enum class format : uint8_t
+        {
+            detect,
+            gzip,
+            zlib
+        };
+
+        using sink_t = std::function<void(const char *data, size_t size)>;
+
+        explicit inflate_stream(format format_in = format::detect);
+
+        // Decompresses as much of the stream as the input so far allows. All of the output is passed to sink before returning. Anything
+        // after the end of the stream is ignored.
+        void feed(const char *data, size_t size, const sink_t &sink);
+
+        // True once the whole stream, including its checksum, has been read.
+        [[nodiscard]] bool done() const noexcept
+        { return stage_v == stage::done; }
+
+        // Throws if the stream ended early.
+        void finish() const;
+
+    private:
+        enum class stage : uint8_t
+        {
+            header,
+            block_header,
+            stored,
+            compressed,
+            trailer,
+            done
+        };
+
+        // Canonical Huffman code. Codes up to fast_bits long are looked up in one step, and anything longer is decoded a bit at a time.
+        struct huffman
+        {
+            constexpr static unsigned fast_bits = 10;
+
+            // symbol << 4 | code length, or 0 for codes longer than fast_bits.
+            std::array<uint16_t, 1 << fast_bits> fast;
+            std::array<uint16_t, 16>             count;
+            std::array<uint16_t, 288>            symbols;
+
+            void build(const uint8_t *lengths, size_t symbol_count);
+        };
+
+        // Where the bit reader was before an atomic step, so it can be put back if the input runs out partway through.
+        struct bit_position
+        {
+            size_t   in_pos;
+            uint64_t bit_buf;
+            unsigned bit_count;
+        };
+
+        static const std::pair<huffman, huffman> &fixed_codes();
+
+        bool read_header();
+        bool read_block_header();
+        bool read_dynamic_codes();
+        bool copy_stored(const sink_t &sink);
+        bool inflate_block(const sink_t &sink);
+        bool read_trailer(const sink_t &sink);
+
+        // Decodes one symbol, or returns -1 if there aren't enough bits yet.
+        int decode(const huffman &code);
+
+        // Bits are read least significant first out of pending, starting at in_pos. need_bits() pulls in whole bytes until there are at
+        // least as many bits as asked for, and returns false if the input runs out first.
+        bool need_bits(unsigned bits);
+        uint32_t take_bits(unsigned bits);
+
+        [[nodiscard]] bit_position position() const noexcept
+        { return { in_pos, bit_buf, bit_count }; }
+
+        // Always returns false, so a step can give up with return rewind(start).
+        bool rewind(const bit_position &start) noexcept
+        {
+            in_pos    = start.in_pos;
+            bit_buf   = start.bit_buf;
+            bit_count = start.bit_count;
+            return false;
+        }
+
+        void make_room(size_t bytes, const sink_t &sink);
+        void flush(const sink_t &sink);
+
+        format format_v;
+        stage  stage_v = stage::header;
+
+        std::vector<uint8_t> pending;
+        size_t               in_pos    = 0;
+        uint64_t             bit_buf   = 0;
+        unsigned             bit_count = 0;
+
+        bool     final_block = false;
+        uint32_t stored_left = 0;
+
+        // Dynamic codes are built in place here, while fixed codes are shared.
+        std::unique_ptr<std::pair<huffman, huffman>> dynamic_codes;
+        const huffman                                *lit_len_code = nullptr;
+        const huffman                                *dist_code    = nullptr;
+
+        std::unique_ptr<uint8_t[]> window;
+        size_t                     out_pos     = 0;
+        size_t                     flushed_pos = 0;
+
+        uint32_t checksum  = 0;
+        uint32_t total_out = 0;
+    };
+}
+
+#endif //MELON_UTIL_INFLATE_STREAM_H
@@ -0,0 +1,51 @@
+#ifndef MELON_UTIL_PARALLEL_H
+#define MELON_UTIL_PARALLEL_H
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <exception>
+#include <thread>
+#include <vector>
+
+namespace melon::util
+{
+    // Calls job(idx) for every idx below jobs on up to threads threads, one per core by default. Jobs are handed out in order as threads finish
+    // their last, and the calling thread takes a share rather than sit waiting. The first exception thrown by any job is rethrown once every
+    // thread has stopped, and no new jobs are started after it.
+    void run_parallel(size_t jobs, unsigned threads, const auto &job)
+    {
+        if (threads == 0) threads = std::max(std::thread::hardware_concurrency(), 1u);
+        threads = static_cast<unsigned>(std::min<size_t>(threads, jobs));
+
+        std::atomic<size_t> next_job{ 0 };
+        std::atomic<bool>   failed{ false };
+        std::exception_ptr  error;
+
+        auto work = [&]() {
+            try
+            {
+                for (size_t idx; !failed.load(std::memory_order_relaxed) && (idx = next_job.fetch_add(1, std::memory_order_relaxed)) < jobs;)
+                    job(idx);
+            }
+            catch (...)
+            {
+                if (!failed.exchange(true)) error = std::current_exception();
+            }
+        };
+
+        {
+            std::vector<std::jthread> workers;
+            workers.reserve(threads > 0 ? threads - 1 : 0);
+
+            for (unsigned idx = 1; idx < threads; idx++)
+                workers.emplace_back(work);
+
+            if (threads > 0) work();
+        }
+
+        if (error) std::rethrow_exception(error);
+    }
+}
+
+#endif //MELON_UTIL_PARALLEL_H
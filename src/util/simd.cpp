@@ -0,0 +1,395 @@
+#include <cstdint>
+#include <cstring>
+#include <array>
+#include <bit>
+#include <initializer_list>
+#include <string_view>
+#include "simd.h"
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define MELON_SIMD_X86 1
+#include <immintrin.h>
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+#else
+#define MELON_SIMD_X86 0
+#endif
+
+// GCC and Clang will only emit instructions outside the baseline ISA in functions that ask for them. MSVC emits anything, anytime.
+#if defined(__GNUC__) || defined(__clang__)
+#define MELON_TARGET(isa_list) __attribute__((target(isa_list)))
+#else
+#define MELON_TARGET(isa_list)
+#endif
+
+namespace melon::util::simd
+{
+    namespace
+    {
+        template<class T>
+        void byteswap_scalar(char *dst, const char *src, std::size_t count) noexcept
+        {
+            for (std::size_t idx = 0; idx < count; idx++)
+            {
+                T value;
+
+                std::memcpy(&value, src, sizeof(T));
+                value = std::byteswap(value);
+                std::memcpy(dst, &value, sizeof(T));
+
+                src += sizeof(T);
+                dst += sizeof(T);
+            }
+        }
+
+        void byteswap_scalar_dispatch(char *dst, const char *src, std::size_t count, std::size_t elem_size) noexcept
+        {
+            switch (elem_size)
+            {
+                // @formatter:off
+                case 2: byteswap_scalar<uint16_t>(dst, src, count); break;
+                case 4: byteswap_scalar<uint32_t>(dst, src, count); break;
+                case 8: byteswap_scalar<uint64_t>(dst, src, count); break;
+                default: std::memcpy(dst, src, count * elem_size); break;
+                // @formatter:on
+            }
+        }
+
+        constexpr auto word_chars = []() {
+            std::array<bool, 256> table{ };
+
+            for (unsigned char c: std::string_view("0123456789ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz+-_."))
+                table[c] = true;
+
+            return table;
+        }();
+
+#if MELON_SIMD_X86
+        // pshufb control bytes reversing each 2, 4, or 8 byte lane of a 16 byte block. The wider kernels shuffle within 128-bit lanes,
+        // so they just repeat this pattern.
+        alignas(16) constexpr int8_t shuffle_masks[3][16] = {
+                { 1, 0, 3, 2, 5, 4, 7, 6, 9, 8, 11, 10, 13, 12, 15, 14 },
+                { 3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8, 15, 14, 13, 12 },
+                { 7, 6, 5, 4, 3, 2, 1, 0, 15, 14, 13, 12, 11, 10, 9, 8 }
+        };
+
+        const int8_t *shuffle_mask_for(std::size_t elem_size) noexcept
+        { return shuffle_masks[std::countr_zero(elem_size) - 1]; }
+
+        // The same patterns already repeated across a whole 64 byte vector. GCC's broadcast and lane shuffle intrinsics both trip
+        // -Wuninitialized on the undefined vector they pass internally, so the AVX-512 kernel loads its mask from here instead.
+        alignas(64) constexpr auto shuffle_masks_512 = []() {
+            std::array<std::array<int8_t, 64>, 3> masks{ };
+
+            for (std::size_t mask = 0; mask < 3; mask++)
+                for (std::size_t idx = 0; idx < 64; idx++)
+                    masks[mask][idx] = shuffle_masks[mask][idx % 16];
+
+            return masks;
+        }();
+
+        MELON_TARGET("ssse3")
+        std::size_t byteswap_ssse3(char *dst, const char *src, std::size_t bytes, std::size_t elem_size) noexcept
+        {
+            const auto mask = _mm_load_si128(reinterpret_cast<const __m128i *>(shuffle_mask_for(elem_size)));
+            std::size_t done = 0;
+
+            for (; done + 64 <= bytes; done += 64)
+            {
+                auto v0 = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src + done));
+                auto v1 = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src + done + 16));
+                auto v2 = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src + done + 32));
+                auto v3 = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src + done + 48));
+
+                _mm_storeu_si128(reinterpret_cast<__m128i *>(dst + done), _mm_shuffle_epi8(v0, mask));
+                _mm_storeu_si128(reinterpret_cast<__m128i *>(dst + done + 16), _mm_shuffle_epi8(v1, mask));
+                _mm_storeu_si128(reinterpret_cast<__m128i *>(dst + done + 32), _mm_shuffle_epi8(v2, mask));
+                _mm_storeu_si128(reinterpret_cast<__m128i *>(dst + done + 48), _mm_shuffle_epi8(v3, mask));
+            }
+
+            for (; done + 16 <= bytes; done += 16)
+            {
+                auto v = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src + done));
+                _mm_storeu_si128(reinterpret_cast<__m128i *>(dst + done), _mm_shuffle_epi8(v, mask));
+            }
+
+            return done;
+        }
+
+        MELON_TARGET("avx2")
+        std::size_t byteswap_avx2(char *dst, const char *src, std::size_t bytes, std::size_t elem_size) noexcept
+        {
+            const auto mask = _mm256_broadcastsi128_si256(_mm_load_si128(reinterpret_cast<const __m128i *>(shuffle_mask_for(elem_size))));
+            std::size_t done = 0;
+
+            for (; done + 128 <= bytes; done += 128)
+            {
+                auto v0 = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(src + done));
+                auto v1 = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(src + done + 32));
+                auto v2 = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(src + done + 64));
+                auto v3 = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(src + done + 96));
+
+                _mm256_storeu_si256(reinterpret_cast<__m256i *>(dst + done), _mm256_shuffle_epi8(v0, mask));
+                _mm256_storeu_si256(reinterpret_cast<__m256i *>(dst + done + 32), _mm256_shuffle_epi8(v1, mask));
+                _mm256_storeu_si256(reinterpret_cast<__m256i *>(dst + done + 64), _mm256_shuffle_epi8(v2, mask));
+                _mm256_storeu_si256(reinterpret_cast<__m256i *>(dst + done + 96), _mm256_shuffle_epi8(v3, mask));
+            }
+
+            for (; done + 32 <= bytes; done += 32)
+            {
+                auto v = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(src + done));
+                _mm256_storeu_si256(reinterpret_cast<__m256i *>(dst + done), _mm256_shuffle_epi8(v, mask));
+            }
+
+            if (done + 16 <= bytes)
+            {
+                auto v = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src + done));
+                _mm_storeu_si128(reinterpret_cast<__m128i *>(dst + done), _mm_shuffle_epi8(v, _mm256_castsi256_si128(mask)));
+                done += 16;
+            }
+
+            return done;
+        }
+
+        MELON_TARGET("avx512f,avx512bw,bmi2")
+        std::size_t byteswap_avx512(char *dst, const char *src, std::size_t bytes, std::size_t elem_size) noexcept
+        {
+            const auto mask = _mm512_load_si512(shuffle_masks_512[std::countr_zero(elem_size) - 1].data());
+            std::size_t done = 0;
+
+            for (; done + 256 <= bytes; done += 256)
+            {
+                auto v0 = _mm512_loadu_si512(src + done);
+                auto v1 = _mm512_loadu_si512(src + done + 64);
+                auto v2 = _mm512_loadu_si512(src + done + 128);
+                auto v3 = _mm512_loadu_si512(src + done + 192);
+
+                _mm512_storeu_si512(dst + done, _mm512_shuffle_epi8(v0, mask));
+                _mm512_storeu_si512(dst + done + 64, _mm512_shuffle_epi8(v1, mask));
+                _mm512_storeu_si512(dst + done + 128, _mm512_shuffle_epi8(v2, mask));
+                _mm512_storeu_si512(dst + done + 192, _mm512_shuffle_epi8(v3, mask));
+            }
+
+            for (; done + 64 <= bytes; done += 64)
+                _mm512_storeu_si512(dst + done, _mm512_shuffle_epi8(_mm512_loadu_si512(src + done), mask));
+
+            // Masked loads and stores finish off the remainder without touching anything past the end of either buffer. The remainder is always a
+            // multiple of the element size, so no element is ever split.
+            if (done < bytes)
+            {
+                auto tail_mask = _bzhi_u64(~0ull, static_cast<unsigned>(bytes - done));
+                auto v         = _mm512_maskz_loadu_epi8(tail_mask, src + done);
+
+                _mm512_mask_storeu_epi8(dst + done, tail_mask, _mm512_shuffle_epi8(v, mask));
+                done = bytes;
+            }
+
+            return done;
+        }
+
+        // The scanning kernels only look at whole blocks, and return where the first block that isn't entirely skipped starts, or where they
+        // stopped. Whatever is left is finished off one byte at a time.
+        MELON_TARGET("ssse3")
+        const char *find_either_ssse3(const char *itr, const char *end, char first, char second) noexcept
+        {
+            const auto first_v  = _mm_set1_epi8(first);
+            const auto second_v = _mm_set1_epi8(second);
+
+            for (; end - itr >= 16; itr += 16)
+            {
+                auto v    = _mm_loadu_si128(reinterpret_cast<const __m128i *>(itr));
+                auto hits = static_cast<unsigned>(_mm_movemask_epi8(_mm_or_si128(_mm_cmpeq_epi8(v, first_v), _mm_cmpeq_epi8(v, second_v))));
+
+                if (hits != 0) return itr + std::countr_zero(hits);
+            }
+
+            return itr;
+        }
+
+        MELON_TARGET("avx2")
+        const char *find_either_avx2(const char *itr, const char *end, char first, char second) noexcept
+        {
+            const auto first_v  = _mm256_set1_epi8(first);
+            const auto second_v = _mm256_set1_epi8(second);
+
+            for (; end - itr >= 32; itr += 32)
+            {
+                auto v    = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(itr));
+                auto hits = static_cast<unsigned>(_mm256_movemask_epi8(_mm256_or_si256(_mm256_cmpeq_epi8(v, first_v), _mm256_cmpeq_epi8(v, second_v))));
+
+                if (hits != 0) return itr + std::countr_zero(hits);
+            }
+
+            return itr;
+        }
+
+        // Letters are folded to lower case by setting bit 5, which can't turn anything else into one. Signed compares are fine, as every byte
+        // at or above 0x80 is negative, and so never in range.
+        MELON_TARGET("ssse3")
+        const char *skip_word_ssse3(const char *itr, const char *end) noexcept
+        {
+            for (; end - itr >= 16; itr += 16)
+            {
+                auto v     = _mm_loadu_si128(reinterpret_cast<const __m128i *>(itr));
+                auto lower = _mm_or_si128(v, _mm_set1_epi8(0x20));
+
+                auto digit = _mm_and_si128(_mm_cmpgt_epi8(v, _mm_set1_epi8('0' - 1)), _mm_cmplt_epi8(v, _mm_set1_epi8('9' + 1)));
+                auto alpha = _mm_and_si128(_mm_cmpgt_epi8(lower, _mm_set1_epi8('a' - 1)), _mm_cmplt_epi8(lower, _mm_set1_epi8('z' + 1)));
+                auto punct = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(v, _mm_set1_epi8('+')), _mm_cmpeq_epi8(v, _mm_set1_epi8('-'))),
+                                          _mm_or_si128(_mm_cmpeq_epi8(v, _mm_set1_epi8('_')), _mm_cmpeq_epi8(v, _mm_set1_epi8('.'))));
+
+                auto misses = ~static_cast<unsigned>(_mm_movemask_epi8(_mm_or_si128(_mm_or_si128(digit, alpha), punct))) & 0xFFFFu;
+                if (misses != 0) return itr + std::countr_zero(misses);
+            }
+
+            return itr;
+        }
+
+        MELON_TARGET("avx2")
+        const char *skip_word_avx2(const char *itr, const char *end) noexcept
+        {
+            for (; end - itr >= 32; itr += 32)
+            {
+                auto v     = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(itr));
+                auto lower = _mm256_or_si256(v, _mm256_set1_epi8(0x20));
+
+                auto digit = _mm256_and_si256(_mm256_cmpgt_epi8(v, _mm256_set1_epi8('0' - 1)), _mm256_cmpgt_epi8(_mm256_set1_epi8('9' + 1), v));
+                auto alpha = _mm256_and_si256(_mm256_cmpgt_epi8(lower, _mm256_set1_epi8('a' - 1)), _mm256_cmpgt_epi8(_mm256_set1_epi8('z' + 1), lower));
+                auto punct = _mm256_or_si256(_mm256_or_si256(_mm256_cmpeq_epi8(v, _mm256_set1_epi8('+')), _mm256_cmpeq_epi8(v, _mm256_set1_epi8('-'))),
+                                             _mm256_or_si256(_mm256_cmpeq_epi8(v, _mm256_set1_epi8('_')), _mm256_cmpeq_epi8(v, _mm256_set1_epi8('.'))));
+
+                auto misses = ~static_cast<unsigned>(_mm256_movemask_epi8(_mm256_or_si256(_mm256_or_si256(digit, alpha), punct)));
+                if (misses != 0) return itr + std::countr_zero(misses);
+            }
+
+            return itr;
+        }
+
+        bool cpu_has(isa level) noexcept
+        {
+#if defined(__GNUC__) || defined(__clang__)
+            __builtin_cpu_init();
+
+            switch (level)
+            {
+                case isa::ssse3: return __builtin_cpu_supports("ssse3");
+                case isa::avx2: return __builtin_cpu_supports("avx2");
+                case isa::avx512: return __builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512bw") && __builtin_cpu_supports("bmi2");
+                default: return true;
+            }
+#elif defined(_MSC_VER)
+            int regs[4];
+            __cpuid(regs, 0);
+            auto max_leaf = regs[0];
+
+            __cpuid(regs, 1);
+            bool ssse3   = (regs[2] & (1 << 9)) != 0;
+            bool osxsave = (regs[2] & (1 << 27)) != 0;
+
+            if (level == isa::ssse3) return ssse3;
+            if (!osxsave || max_leaf < 7) return false;
+
+            auto xcr0 = _xgetbv(0);
+            __cpuidex(regs, 7, 0);
+
+            bool avx2_state   = (xcr0 & 0x06) == 0x06;
+            bool avx512_state = (xcr0 & 0xE6) == 0xE6;
+
+            if (level == isa::avx2) return avx2_state && (regs[1] & (1 << 5)) != 0;
+            if (level == isa::avx512) return avx512_state && (regs[1] & (1 << 16)) != 0 && (regs[1] & (1 << 30)) != 0 && (regs[1] & (1 << 8)) != 0;
+
+            return true;
+#else
+            return level == isa::scalar;
+#endif
+        }
+#endif
+
+        isa detect() noexcept
+        {
+#if MELON_SIMD_X86
+            for (auto level: { isa::avx512, isa::avx2, isa::ssse3 })
+                if (cpu_has(level)) return level;
+#endif
+
+            return isa::scalar;
+        }
+    }
+
+    isa detected_isa() noexcept
+    {
+        static const isa level = detect();
+        return level;
+    }
+
+    void byteswap_copy(void *dst, const void *src, std::size_t count, std::size_t elem_size) noexcept
+    {
+        auto dst_itr = static_cast<char *>(dst);
+        auto src_itr = static_cast<const char *>(src);
+        auto bytes   = count * elem_size;
+
+        std::size_t done = 0;
+
+        if (elem_size < 2)
+        {
+            if (bytes > 0) std::memcpy(dst_itr, src_itr, bytes);
+            return;
+        }
+
+#if MELON_SIMD_X86
+        if (elem_size == 2 || elem_size == 4 || elem_size == 8)
+        {
+            switch (detected_isa())
+            {
+                // @formatter:off
+                case isa::avx512: done = byteswap_avx512(dst_itr, src_itr, bytes, elem_size); break;
+                case isa::avx2: done = byteswap_avx2(dst_itr, src_itr, bytes, elem_size); break;
+                case isa::ssse3: done = byteswap_ssse3(dst_itr, src_itr, bytes, elem_size); break;
+                default: break;
+                // @formatter:on
+            }
+        }
+#endif
+
+        byteswap_scalar_dispatch(dst_itr + done, src_itr + done, (bytes - done) / elem_size, elem_size);
+    }
+
+    // Both scans usually stop within a few bytes, so the widest kernel is only worth it up to AVX2, where a whole block is a single load.
+    const char *find_either(const char *itr, const char *end, char first, char second) noexcept
+    {
+#if MELON_SIMD_X86
+        switch (detected_isa())
+        {
+            // @formatter:off
+            case isa::avx512:
+            case isa::avx2: itr = find_either_avx2(itr, end, first, second); break;
+            case isa::ssse3: itr = find_either_ssse3(itr, end, first, second); break;
+            default: break;
+            // @formatter:on
+        }
+#endif
+
+        while (itr != end && *itr != first && *itr != second) itr++;
+        return itr;
+    }
+
+    const char *skip_word(const char *itr, const char *end) noexcept
+    {
+#if MELON_SIMD_X86
+        switch (detected_isa())
+        {
+            // @formatter:off
+            case isa::avx512:
+            case isa::avx2: itr = skip_word_avx2(itr, end); break;
+            case isa::ssse3: itr = skip_word_ssse3(itr, end); break;
+            default: break;
+            // @formatter:on
+        }
+#endif
+
+        while (itr != end && word_chars[static_cast<unsigned char>(*itr)]) itr++;
+        return itr;
+    }
+}
@@ -0,0 +1,52 @@
+#ifndef MELON_UTIL_SIMD_H
+#define MELON_UTIL_SIMD_H
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <bit>
+
+namespace melon::util::simd
+{
+    enum class isa : uint8_t
+    {
+        scalar,
+        ssse3,
+        avx2,
+        avx512
+    };
+
+    // The best instruction set available on the running CPU. Detected once on first use.
+    isa detected_isa() noexcept;
+
+    // Copies count elements of elem_size bytes (2, 4, or 8) from src to dst, reversing the byte order of each element along the way.
+    // Neither pointer needs to be aligned, and nothing outside of [src, src + count * elem_size) is read. The buffers must not overlap.
+    void byteswap_copy(void *dst, const void *src, std::size_t count, std::size_t elem_size) noexcept;
+
+    // The first byte in [itr, end) equal to either first or second, or end if there isn't one. Nothing past end is read.
+    const char *find_either(const char *itr, const char *end, char first, char second) noexcept;
+
+    // The first byte in [itr, end) that isn't an ASCII letter, digit, or one of "+-_.", or end if there isn't one. Nothing past end is read.
+    const char *skip_word(const char *itr, const char *end) noexcept;
+}
+
+namespace melon::util
+{
+    // Bulk version of cvt_endian for arrays of integral types. Decays to a plain memcpy when no conversion is necessary.
+    template<auto src_endian = std::endian::big, auto target_endian = std::endian::native>
+    void cvt_endian_array(void *dst, const void *src, std::size_t count, std::size_t elem_size) noexcept
+    {
+        if constexpr (target_endian != src_endian)
+        {
+            if (elem_size > 1)
+            {
+                simd::byteswap_copy(dst, src, count, elem_size);
+                return;
+            }
+        }
+
+        if (count > 0) std::memcpy(dst, src, count * elem_size);
+    }
+}
+
+#endif //MELON_UTIL_SIMD_H